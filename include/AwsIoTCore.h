@@ -8,25 +8,139 @@
 #include <ArduinoJson.h>
 #include <PubSubClient.h>
 #include <Array.h>
+#include <functional>
+#include <type_traits>
+
+#include "AwsIoTMetrics.h"
+
+// Subsystems can be compiled out on small targets with -DAWS_IOT_DISABLE_JOBS and -DAWS_IOT_DISABLE_COMMANDS.
+// The matching subscriptions, dispatch checks, API and members are then removed.
+
+#ifdef AWS_IOT_DISABLE_JOBS
+#define AWS_IOT_HAS_JOBS false
+#else
+#define AWS_IOT_HAS_JOBS true
+#endif
+
+#ifdef AWS_IOT_DISABLE_COMMANDS
+#define AWS_IOT_HAS_COMMANDS false
+#else
+#define AWS_IOT_HAS_COMMANDS true
+#endif
+
+#ifdef AWS_IOT_METRICS
+#define AWS_IOT_HAS_METRICS true
+#else
+#define AWS_IOT_HAS_METRICS false
+#endif
+
+// The feature flags have to match between the library and every sketch file using it. The client constructors take
+// this tag as a defaulted parameter, its type changes the mangled constructor name, so a mismatch fails to link.
+template<bool Jobs, bool Commands, bool Metrics>
+struct AwsIoTBuildConfig {
+};
+
+typedef AwsIoTBuildConfig<AWS_IOT_HAS_JOBS, AWS_IOT_HAS_COMMANDS, AWS_IOT_HAS_METRICS> AwsIoTBuildFlags;
 
 class FleetProvisioningClient;
 
 class ThingClient;
 
-// typedef bool (*ThingClientCallback)(const String &topic, JsonDocument payload);
+class TraceRecorder;
+
+class OutboundScheduler;
+
+typedef bool (*ThingClientCallbackFunction)(const String &shadowName, JsonDocument &payload);
 #define ThingClientCallback std::function<bool(const String &shadowName, JsonDocument &payload)>
 
-// typedef bool (*ThingClientShadowCallback)(const String &shadowName, const JsonObject &payload);
+typedef bool (*ThingClientCommandCallbackFunction)(const String &executionId, JsonDocument &payload);
 #define ThingClientCommandCallback std::function<bool(const String &executionId, JsonDocument &payload)>
 
-// typedef bool (*ThingClientShadowCallback)(const String &shadowName, const JsonObject &payload);
+typedef bool (*ThingClientJobsCallbackFunction)(const String &jobId, JsonDocument &payload);
 #define ThingClientJobsCallback std::function<bool(const String &jobId, JsonDocument &payload)>
 
-// typedef bool (*ThingClientShadowCallback)(const String &shadowName, const JsonObject &payload);
+typedef bool (*ThingClientShadowCallbackFunction)(const String &shadowName, JsonObject &payload, bool shouldMutate);
 #define ThingClientShadowCallback std::function<bool(const String &shadowName, JsonObject &payload, bool shouldMutate)>
 
+typedef bool (*ThingClientMessageCallbackFunction)(const String &shadowName, JsonDocument &payload);
 #define ThingClientMessageCallback std::function<bool(const String &shadowName, JsonDocument &payload)>
 
+// Holds a callback as either a plain function pointer, called directly, or a std::function for capturing lambdas.
+// The std::function is only allocated when one is set, so an unset or plain callback costs two words.
+template<typename Signature>
+class AwsCallback;
+
+template<typename R, typename... Args>
+class AwsCallback<R(Args...)> {
+    union {
+        R (*function)(Args...);
+        std::function<R(Args...)> *callable;
+    };
+    bool isCallable;
+
+    void clear() {
+        if (this->isCallable) {
+            delete this->callable;
+        }
+        this->function = nullptr;
+        this->isCallable = false;
+    }
+
+public:
+    AwsCallback() : function(nullptr), isCallable(false) {
+    }
+
+    AwsCallback(const AwsCallback &other) : function(nullptr), isCallable(false) {
+        *this = other;
+    }
+
+    ~AwsCallback() {
+        clear();
+    }
+
+    AwsCallback &operator=(const AwsCallback &other) {
+        if (this != &other) {
+            if (other.isCallable) {
+                *this = *other.callable;
+            } else {
+                *this = other.function;
+            }
+        }
+        return *this;
+    }
+
+    AwsCallback &operator=(R (*function)(Args...)) {
+        clear();
+        this->function = function;
+        return *this;
+    }
+
+    AwsCallback &operator=(std::function<R(Args...)> callable) {
+        clear();
+        if (callable != nullptr) {
+            this->callable = new std::function<R(Args...)>(std::move(callable));
+            this->isCallable = true;
+        }
+        return *this;
+    }
+
+    bool operator==(std::nullptr_t) const { return !this->isCallable && this->function == nullptr; }
+
+    bool operator!=(std::nullptr_t) const { return !(*this == nullptr); }
+
+    R operator()(Args... args) const {
+        return this->isCallable ? (*this->callable)(args...) : this->function(args...);
+    }
+};
+
+// Picks the function pointer type for anything convertible to it (functions, captureless lambdas, nullptr)
+// and the std::function type otherwise. Lets the template setters below route to the cheaper overload.
+template<typename Function, typename Callable, typename F>
+typename std::conditional<std::is_convertible<F, Function>::value, Function, Callable>::type
+awsCallbackTarget(F callback) {
+    return callback;
+}
+
 struct CommandReply {
     String status;
     String statusCode;
@@ -42,30 +156,71 @@ struct JobReply {
 
 class ThingClient {
 private:
-    ThingClientCallback callback;
-    ThingClientCommandCallback commandCallback;
-    ThingClientJobsCallback jobsCallback;
-    ThingClientShadowCallback shadowCallback;
-    ThingClientMessageCallback messageCallback;
+    AwsCallback<bool(const String &, JsonDocument &)> callback;
+#ifndef AWS_IOT_DISABLE_COMMANDS
+    AwsCallback<bool(const String &, JsonDocument &)> commandCallback;
+#endif
+#ifndef AWS_IOT_DISABLE_JOBS
+    AwsCallback<bool(const String &, JsonDocument &)> jobsCallback;
+#endif
+    AwsCallback<bool(const String &, JsonObject &, bool)> shadowCallback;
+    AwsCallback<bool(const String &, JsonDocument &)> messageCallback;
     JsonDocument shadows;
 
     PubSubClient *client;
     String thingName;
+    TraceRecorder *traceRecorder;
+    OutboundScheduler *outboundScheduler;
+
+    String thingTopic;
+    String shadowPrefix;
+#ifndef AWS_IOT_DISABLE_JOBS
+    String jobsPrefix;
+#endif
+#ifndef AWS_IOT_DISABLE_COMMANDS
+    String commandPrefix;
+#endif
 
     bool isRunning;
     bool isClassicReceived;
+#ifndef AWS_IOT_DISABLE_JOBS
     bool listPendingJobsRequested;
+#endif
+
+#ifdef AWS_IOT_METRICS
+    ThingClientMetrics metrics;
+    String metricsShadowName;
+    unsigned long metricsInterval;
+    unsigned long metricsPublishedAt;
+    unsigned long heapSampledAt;
+#endif
+
+    bool publish(AwsRouteClass route, const String &topic, const String &payload);
 
+    bool dispatchMessage(const String &topic, JsonDocument &payload, AwsRouteClass &route);
+
+    bool isRegistered(const String &shadowName);
+
+#ifndef AWS_IOT_DISABLE_COMMANDS
     bool processCommandMessage(const String &topic, JsonDocument &payload);
+#endif
 
+#ifndef AWS_IOT_DISABLE_JOBS
     bool processJobMessage(const String &topic, JsonDocument &payload);
+#endif
 
     bool processShadowMessage(const String &topic, JsonDocument &payload);
 
     bool processMessage(const String &topic, JsonDocument &payload);
 
 public:
-    ThingClient(PubSubClient *client, const String &thingName);
+    ThingClient(PubSubClient *client, const String &thingName, AwsIoTBuildFlags flags = AwsIoTBuildFlags());
+
+    ~ThingClient();
+
+    ThingClient(const ThingClient &) = delete;
+
+    ThingClient &operator=(const ThingClient &) = delete;
 
     void registerShadow(const String &shadowName);
 
@@ -81,44 +236,149 @@ public:
 
     JsonObject getShadow(const String &shadowName);
 
+#ifndef AWS_IOT_DISABLE_JOBS
     void listPendingJobs();
 
     void startPendingJobs(unsigned int startPendingJobs = 0);
 
-    void commandReply(const String &executionId, const CommandReply &payload);
-
     void jobReply(const String &jobId, const JobReply &payload);
 
     void requestJobDetail(const String &jobId);
+#endif
+
+#ifndef AWS_IOT_DISABLE_COMMANDS
+    void commandReply(const String &executionId, const CommandReply &payload);
+#endif
 
     void begin();
 
     void end();
 
+    // Each setter takes a std::function or a plain function pointer. The template overload sends functions and
+    // captureless lambdas to the pointer version, which is called without std::function's type erasure.
     void setCallback(ThingClientCallback callback);
 
+    void setCallback(ThingClientCallbackFunction callback);
+
+    template<typename F>
+    void setCallback(F callback) {
+        setCallback(awsCallbackTarget<ThingClientCallbackFunction, ThingClientCallback>(callback));
+    }
+
+#ifndef AWS_IOT_DISABLE_COMMANDS
     void setCommandCallback(ThingClientCommandCallback callback);
 
+    void setCommandCallback(ThingClientCommandCallbackFunction callback);
+
+    template<typename F>
+    void setCommandCallback(F callback) {
+        setCommandCallback(awsCallbackTarget<ThingClientCommandCallbackFunction, ThingClientCommandCallback>(callback));
+    }
+#endif
+
+#ifndef AWS_IOT_DISABLE_JOBS
     void setJobsCallback(ThingClientJobsCallback callback);
 
+    void setJobsCallback(ThingClientJobsCallbackFunction callback);
+
+    template<typename F>
+    void setJobsCallback(F callback) {
+        setJobsCallback(awsCallbackTarget<ThingClientJobsCallbackFunction, ThingClientJobsCallback>(callback));
+    }
+#endif
+
     void setShadowCallback(ThingClientShadowCallback callback);
 
+    void setShadowCallback(ThingClientShadowCallbackFunction callback);
+
+    template<typename F>
+    void setShadowCallback(F callback) {
+        setShadowCallback(awsCallbackTarget<ThingClientShadowCallbackFunction, ThingClientShadowCallback>(callback));
+    }
+
     void setMessageCallback(ThingClientMessageCallback callback);
 
-    bool onMessage(const String &topic, JsonDocument &payload);
+    void setMessageCallback(ThingClientMessageCallbackFunction callback);
+
+    template<typename F>
+    void setMessageCallback(F callback) {
+        setMessageCallback(awsCallbackTarget<ThingClientMessageCallbackFunction, ThingClientMessageCallback>(callback));
+    }
+
+    void setTraceRecorder(TraceRecorder *traceRecorder);
+
+    void setOutboundScheduler(OutboundScheduler *outboundScheduler);
+
+    bool publishTelemetry(const String &topic, const String &payload);
+
+    // length is the raw MQTT payload size as handed to the PubSubClient callback, it only feeds the byte counters.
+    // Without it only the topic bytes are counted.
+    bool onMessage(const String &topic, JsonDocument &payload, unsigned int length = 0);
 
     void loop();
+
+#ifdef AWS_IOT_METRICS
+    const ThingClientMetrics &getMetrics() const;
+
+    void resetMetrics();
+
+    // The report has to fit the PubSubClient buffer (256 bytes by default), raise it with client.setBufferSize(512)
+    // to get the histogram buckets. Falls back to a report without buckets, and returns false when even that does not fit.
+    bool publishMetrics(const String &shadowName);
+
+    void setMetricsReporting(const String &shadowName, unsigned long interval);
+#endif
 };
 
-// typedef bool (*FleetProvisioningClientCallback)(const String &topic, const JsonDocument &payload);
+typedef bool (*FleetProvisioningClientCallbackFunction)(const String &topic, JsonDocument &payload);
 #define FleetProvisioningClientCallback std::function<bool(const String &topic,  JsonDocument &payload)>
 
+enum FleetProvisioningOutcome {
+    PROVISIONING_PENDING,
+    PROVISIONING_SUCCEEDED,
+    PROVISIONING_REJECTED,
+    PROVISIONING_FAILED
+};
+
+struct FleetProvisioningTimings {
+    unsigned long createRequestedAt;
+    unsigned long createAcceptedAt;
+    unsigned long provisionRequestedAt;
+    // Set for both the accepted and the rejected response, outcome tells them apart.
+    unsigned long provisionRespondedAt;
+    unsigned long completedAt;
+    FleetProvisioningOutcome outcome;
+};
+
+enum FleetProvisioningPhase {
+    PHASE_IDLE,
+    PHASE_AWAITING_CERTIFICATE,
+    PHASE_AWAITING_REGISTRATION,
+    PHASE_DONE
+};
+
+// Certificate and registration responses carry no client token, AWS IoT routes them by connection only.
+// Give every FleetProvisioningClient its own PubSubClient connection: instances sharing one would all receive
+// each $aws/certificates/create/json/accepted response. A client only acts on the responses of the phase it is
+// waiting in, so a stray response is ignored rather than provisioning a second certificate.
 class FleetProvisioningClient {
     PubSubClient *client;
     String provisioningName;
     String thingName;
+    String keystorePath;
+
+    String provisionTopic;
+    String provisionAcceptedTopic;
+    String provisionRejectedTopic;
 
     bool isRunning;
+    FleetProvisioningPhase phase;
+    FleetProvisioningTimings timings;
+#ifdef AWS_IOT_METRICS
+    FleetProvisioningMetrics metrics;
+#endif
+
+    bool publish(const String &topic, const String &payload);
 
     void saveCertificate(JsonDocument &payload);
 
@@ -126,10 +386,13 @@ class FleetProvisioningClient {
 
     bool acceptProvisioning(JsonDocument &payload);
 
-    FleetProvisioningClientCallback callback;
+    void finish(FleetProvisioningOutcome outcome);
+
+    AwsCallback<bool(const String &, JsonDocument &)> callback;
 
 public:
-    FleetProvisioningClient(PubSubClient *client, const String &provisioningName, const String &thingName);
+    FleetProvisioningClient(PubSubClient *client, const String &provisioningName, const String &thingName,
+                            AwsIoTBuildFlags flags = AwsIoTBuildFlags());
 
     void begin();
 
@@ -137,7 +400,26 @@ public:
 
     void setCallback(FleetProvisioningClientCallback callback);
 
-    bool onMessage(const String &topic, JsonDocument &payload);
+    void setCallback(FleetProvisioningClientCallbackFunction callback);
+
+    template<typename F>
+    void setCallback(F callback) {
+        setCallback(awsCallbackTarget<FleetProvisioningClientCallbackFunction, FleetProvisioningClientCallback>(callback));
+    }
+
+    void setKeystorePath(const String &keystorePath);
+
+    const FleetProvisioningTimings &getTimings() const;
+
+    FleetProvisioningPhase getPhase() const;
+
+#ifdef AWS_IOT_METRICS
+    const FleetProvisioningMetrics &getMetrics() const;
+
+    void resetMetrics();
+#endif
+
+    bool onMessage(const String &topic, JsonDocument &payload, unsigned int length = 0);
 };
 
 
@@ -0,0 +1,96 @@
+#ifndef AWSIOTMETRICS_H
+#define AWSIOTMETRICS_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Metrics are opt-in: build with -DAWS_IOT_METRICS to compile the counters into the clients.
+// ThingClient and FleetProvisioningClient then hold their counters by value. Without the flag the clients have no
+// metrics members and the hot paths carry no extra checks.
+
+#define AWS_METRICS_HISTOGRAM_BUCKETS 20
+#define AWS_METRICS_HEAP_INTERVAL 1000
+
+enum AwsRouteClass : uint8_t {
+    ROUTE_SHADOW = 0,
+    ROUTE_JOB,
+    ROUTE_COMMAND,
+    ROUTE_CUSTOM,
+    ROUTE_CLASS_COUNT
+};
+
+const char *routeClassName(AwsRouteClass route);
+
+// Log2 histogram of durations in microseconds.
+// Bucket 0 holds 0us, bucket i holds [2^(i-1), 2^i) us, and the last bucket collects everything above.
+// Only non-empty buckets are reported, as {"<index>": count}, to keep the report within an MQTT packet.
+struct AwsLatencyHistogram {
+    uint32_t buckets[AWS_METRICS_HISTOGRAM_BUCKETS];
+    uint32_t count;
+    uint32_t maxMicros;
+    uint64_t totalMicros;
+
+    void record(uint32_t micros);
+
+    void reset();
+
+    void toJson(JsonObject out, bool withBuckets = true) const;
+};
+
+struct AwsRouteMetrics {
+    uint32_t messagesIn;
+    uint32_t bytesIn;
+    uint32_t messagesOut;
+    uint32_t bytesOut;
+    AwsLatencyHistogram handlerMicros;
+
+    void recordInbound(size_t bytes, uint32_t micros);
+
+    void recordOutbound(size_t bytes);
+
+    bool isEmpty() const;
+
+    void reset();
+
+    void toJson(JsonObject out, bool withBuckets = true) const;
+};
+
+// Heap samples for long running soak tests, fragmentation shows up as a largest block much smaller than free heap.
+struct AwsHeapStats {
+    uint32_t freeHeap;
+    uint32_t lowestFreeHeap;
+    uint32_t largestFreeBlock;
+
+    void sample();
+
+    void reset();
+
+    void toJson(JsonObject out) const;
+};
+
+struct ThingClientMetrics {
+    AwsRouteMetrics routes[ROUTE_CLASS_COUNT];
+    uint32_t unhandledMessages;
+    uint32_t publishFailures;
+    uint32_t rejectedResponses;
+    uint32_t retries;
+    AwsHeapStats heap;
+
+    void reset();
+
+    // Routes without traffic are left out.
+    void toJson(JsonObject out, bool withBuckets = true) const;
+};
+
+struct FleetProvisioningMetrics {
+    uint32_t messagesIn;
+    uint32_t bytesIn;
+    uint32_t publishFailures;
+    uint32_t rejectedResponses;
+
+    void reset();
+
+    void toJson(JsonObject out) const;
+};
+
+#endif //AWSIOTMETRICS_H
@@ -0,0 +1,149 @@
+#ifndef AWSLOG_H
+#define AWSLOG_H
+
+#include <Arduino.h>
+#include <atomic>
+
+// Deferred logging: build with -DAWS_IOT_DEFERRED_LOG to make the AWS_LOG_* macros push compact records
+// (format pointer plus raw arguments) into a ring buffer instead of calling Serial.printf. Records are
+// formatted later by AwsLog.loop(), which ThingClient::loop() calls, or pulled out with AwsLog.read().
+// The level is selected at runtime with AwsLog.setLevel().
+//
+// The ring is single producer / single consumer: log from one task, drain from one task.
+//
+// Without the flag the macros fall back to the classic LOG_INFO / LOG_DEBUG / LOG_TRACE Serial.printf output.
+
+#ifndef AWS_LOG_RING_SIZE
+#define AWS_LOG_RING_SIZE 32
+#endif
+
+#define AWS_LOG_MAX_ARGS 4
+#define AWS_LOG_TEXT_SIZE 48
+
+static_assert((AWS_LOG_RING_SIZE & (AWS_LOG_RING_SIZE - 1)) == 0, "AWS_LOG_RING_SIZE must be a power of two");
+
+enum AwsLogLevel : uint8_t {
+    AWS_LOG_LEVEL_NONE = 0,
+    AWS_LOG_LEVEL_ERROR,
+    AWS_LOG_LEVEL_INFO,
+    AWS_LOG_LEVEL_DEBUG,
+    AWS_LOG_LEVEL_TRACE
+};
+
+struct AwsLogRecord {
+    uint32_t timestamp;
+    const char *format;
+    AwsLogLevel level;
+    uint8_t argc;
+    uint8_t textLength;
+    uint32_t args[AWS_LOG_MAX_ARGS];
+    // String arguments are copied here back to back, each NUL terminated, and truncated when the space runs out.
+    char text[AWS_LOG_TEXT_SIZE];
+};
+
+class AwsLogRing {
+    AwsLogRecord records[AWS_LOG_RING_SIZE];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    // Bumped by the producer when the ring is full and read by the drain side, so it is shared like head and tail.
+    std::atomic<uint32_t> dropped;
+    uint32_t reportedDropped;
+
+    AwsLogLevel level;
+    Print *output;
+    size_t drainBudget;
+
+    void encode(AwsLogRecord &) {
+    }
+
+    template<typename T, typename... Args>
+    void encode(AwsLogRecord &record, const T &arg, const Args &... args) {
+        encodeArg(record, arg);
+        encode(record, args...);
+    }
+
+    void encodeArg(AwsLogRecord &record, const char *arg);
+
+    void encodeArg(AwsLogRecord &record, const String &arg);
+
+    void encodeArg(AwsLogRecord &record, unsigned long arg);
+
+    void encodeArg(AwsLogRecord &record, long arg) { encodeArg(record, (unsigned long) arg); }
+
+    void encodeArg(AwsLogRecord &record, unsigned int arg) { encodeArg(record, (unsigned long) arg); }
+
+    void encodeArg(AwsLogRecord &record, int arg) { encodeArg(record, (unsigned long) arg); }
+
+    AwsLogRecord *reserve();
+
+    void commit();
+
+public:
+    AwsLogRing();
+
+    void setLevel(AwsLogLevel level);
+
+    AwsLogLevel getLevel() const;
+
+    bool isEnabled(AwsLogLevel level) const {
+        return level <= this->level;
+    }
+
+    void setOutput(Print *output, size_t drainBudget = 4);
+
+    template<typename... Args>
+    void log(AwsLogLevel level, const char *format, const Args &... args) {
+        if (!isEnabled(level)) {
+            return;
+        }
+
+        AwsLogRecord *record = reserve();
+        if (record == nullptr) {
+            return;
+        }
+
+        record->timestamp = millis();
+        record->format = format;
+        record->level = level;
+        record->argc = 0;
+        record->textLength = 0;
+        encode(*record, args...);
+        commit();
+    }
+
+    bool read(AwsLogRecord &record);
+
+    size_t format(const AwsLogRecord &record, char *buffer, size_t size) const;
+
+    size_t drain(Print &out, size_t maxRecords);
+
+    uint32_t getDropped() const;
+
+    void loop();
+};
+
+extern AwsLogRing AwsLog;
+
+#ifdef AWS_IOT_DEFERRED_LOG
+#define AWS_LOG_INFO(format, ...) AwsLog.log(AWS_LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define AWS_LOG_DEBUG(format, ...) AwsLog.log(AWS_LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#define AWS_LOG_TRACE(format, ...) AwsLog.log(AWS_LOG_LEVEL_TRACE, format, ##__VA_ARGS__)
+#else
+#ifdef LOG_INFO
+#define AWS_LOG_INFO(format, ...) Serial.printf("[INFO] " format "\n", ##__VA_ARGS__)
+#else
+#define AWS_LOG_INFO(format, ...)
+#endif
+#ifdef LOG_DEBUG
+#define AWS_LOG_DEBUG(format, ...) Serial.printf("[DEBUG] " format "\n", ##__VA_ARGS__)
+#else
+#define AWS_LOG_DEBUG(format, ...)
+#endif
+#ifdef LOG_TRACE
+#define AWS_LOG_TRACE(format, ...) Serial.printf("[TRACE] " format "\n", ##__VA_ARGS__)
+#else
+#define AWS_LOG_TRACE(format, ...)
+#endif
+#endif
+
+#endif //AWSLOG_H
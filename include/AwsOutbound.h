@@ -0,0 +1,116 @@
+#ifndef AWSOUTBOUND_H
+#define AWSOUTBOUND_H
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <functional>
+
+// Outbound publish scheduler with one token bucket per lane plus one for the whole connection.
+// Lanes are served in strict priority order and each one has a bounded queue.
+
+#ifndef AWS_OUTBOUND_QUEUE_SIZE
+#define AWS_OUTBOUND_QUEUE_SIZE 8
+#endif
+
+static_assert(AWS_OUTBOUND_QUEUE_SIZE > 0 && AWS_OUTBOUND_QUEUE_SIZE <= 255,
+              "AWS_OUTBOUND_QUEUE_SIZE must fit the uint8_t queue head and count");
+
+// AWS IoT Core allows 100 publishes per second on a single connection.
+#define AWS_OUTBOUND_CONNECTION_RATE 100
+
+enum AwsPublishLane : uint8_t {
+    LANE_COMMAND = 0,
+    LANE_JOB,
+    LANE_SHADOW,
+    LANE_TELEMETRY,
+    LANE_COUNT
+};
+
+enum AwsDropPolicy : uint8_t {
+    DROP_NEWEST = 0,
+    DROP_OLDEST
+};
+
+// Final outcome of every message handed to the scheduler: sent, failed to publish, or dropped from a full queue.
+#define AwsOutboundCallback std::function<void(AwsPublishLane lane, size_t bytes, bool published)>
+
+struct AwsTokenBucket {
+    uint32_t rate;
+    uint32_t capacity;
+    uint32_t level;
+    unsigned long refilledAt;
+
+    // A rate of 0 disables the limit. Levels are kept in thousandths of a token to stay in integer math.
+    void configure(uint16_t perSecond, uint16_t burst);
+
+    bool available(unsigned long now);
+
+    void take();
+};
+
+struct AwsLaneStats {
+    uint32_t published;
+    uint32_t queued;
+    uint32_t dropped;
+    uint32_t failed;
+    uint16_t highWatermark;
+};
+
+struct AwsOutboundMessage {
+    String topic;
+    String payload;
+};
+
+class OutboundScheduler {
+    struct Lane {
+        AwsTokenBucket bucket;
+        AwsDropPolicy dropPolicy;
+        AwsOutboundMessage queue[AWS_OUTBOUND_QUEUE_SIZE];
+        uint8_t head;
+        uint8_t count;
+        AwsLaneStats stats;
+    };
+
+    PubSubClient *client;
+    AwsTokenBucket connectionBucket;
+    Lane lanes[LANE_COUNT];
+    AwsOutboundCallback outcomeCallback;
+
+    bool canSend(Lane &lane, unsigned long now);
+
+    bool send(Lane &lane, const String &topic, const String &payload);
+
+    bool enqueue(AwsPublishLane lane, const String &topic, const String &payload);
+
+    void report(AwsPublishLane lane, const String &topic, const String &payload, bool published);
+
+    bool sendable(Lane &lane, unsigned long now);
+
+    bool hasSendableAbove(AwsPublishLane lane, unsigned long now);
+
+public:
+    explicit OutboundScheduler(PubSubClient *client);
+
+    void setRate(AwsPublishLane lane, uint16_t perSecond, uint16_t burst);
+
+    void setConnectionRate(uint16_t perSecond, uint16_t burst);
+
+    void setDropPolicy(AwsPublishLane lane, AwsDropPolicy dropPolicy);
+
+    // Called once per message when it is sent, fails to publish, or is dropped, including queued messages
+    // sent from loop() and the ones DROP_OLDEST evicts. ThingClient uses it to keep its metrics accurate.
+    void setOutcomeCallback(AwsOutboundCallback callback);
+
+    // Sends right away when loop() would send it now, otherwise queues the message.
+    // Returns false when the message was dropped or the publish failed. A queued message returns true,
+    // its final outcome is reported through the outcome callback.
+    bool publish(AwsPublishLane lane, const String &topic, const String &payload);
+
+    void loop();
+
+    size_t pending(AwsPublishLane lane) const;
+
+    const AwsLaneStats &getStats(AwsPublishLane lane) const;
+};
+
+#endif //AWSOUTBOUND_H
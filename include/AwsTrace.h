@@ -0,0 +1,114 @@
+#ifndef AWSTRACE_H
+#define AWSTRACE_H
+
+#include <FS.h>
+
+#include "AwsIoTCore.h"
+
+// Binary trace of inbound messages, used to reproduce field traffic against ThingClient.
+//
+// File layout (little endian):
+//   header: "AWTR" magic, uint8 version
+//   record: uint32 millis since recording started, uint16 topic length, uint32 payload length,
+//           topic bytes, payload encoded as MessagePack
+
+#define AWS_TRACE_VERSION 1
+#define AWS_TRACE_RECORD_HEADER_SIZE 10
+
+// Records are staged in RAM and written out from loop(), a record larger than the buffer is counted as failed.
+#ifndef AWS_TRACE_BUFFER_SIZE
+#define AWS_TRACE_BUFFER_SIZE 2048
+#endif
+
+#define AWS_TRACE_FLUSH_INTERVAL 1000
+#define AWS_TRACE_TOPIC_RESERVE 128
+#define AWS_TRACE_ALLOCATOR_BINS 10
+
+class TraceRecorder {
+    File file;
+    bool isRecording;
+    unsigned long startedAt;
+    unsigned long flushedAt;
+    uint32_t records;
+    uint32_t failedRecords;
+
+    uint8_t buffer[AWS_TRACE_BUFFER_SIZE];
+    size_t buffered;
+    uint32_t bufferedRecords;
+
+    bool stage(const String &topic, JsonDocument &payload);
+
+public:
+    TraceRecorder();
+
+    bool begin(fs::FS &fs, const String &path);
+
+    void end();
+
+    // Called from ThingClient::onMessage(). Serializes into the RAM buffer and only touches the file when it is full.
+    bool record(const String &topic, JsonDocument &payload);
+
+    // Writes the buffer out once it is half full or a second has passed. ThingClient::loop() calls it.
+    void loop();
+
+    // Writes buffered records and flushes the file. A short write stops the recording, the file ends at the last
+    // complete record.
+    bool flush();
+
+    // Records written to the file, buffered ones are not counted until they are flushed.
+    uint32_t getRecordCount() const;
+
+    // Records lost because they did not fit the buffer or the file write failed.
+    uint32_t getFailedCount() const;
+};
+
+// Keeps the blocks a JsonDocument frees in power of two bins and hands them out again, so replaying one record
+// after another settles into reusing the same memory instead of going back to the heap for every message.
+class TraceReplayAllocator : public ArduinoJson::Allocator {
+    void *bins[AWS_TRACE_ALLOCATOR_BINS];
+
+public:
+    TraceReplayAllocator();
+
+    ~TraceReplayAllocator();
+
+    void *allocate(size_t size) override;
+
+    void deallocate(void *pointer) override;
+
+    void *reallocate(void *pointer, size_t new_size) override;
+
+    // Returns the cached blocks to the heap.
+    void release();
+};
+
+struct TraceReplayStats {
+    uint32_t messages;
+    uint32_t handled;
+    uint32_t errors;
+    uint64_t elapsedMicros;
+    AwsLatencyHistogram dispatchMicros;
+    uint32_t heapBefore;
+    uint32_t heapAfter;
+    uint32_t heapLowest;
+};
+
+class TraceReplayer {
+    uint8_t *buffer;
+    size_t bufferSize;
+    String topic;
+    TraceReplayAllocator allocator;
+
+    bool readInto(File &file, size_t length);
+
+public:
+    TraceReplayer();
+
+    ~TraceReplayer();
+
+    // Feeds every record into client.onMessage(), with the MessagePack size as the payload length.
+    // A speed of 1.0 keeps the recorded timing, higher values compress it, and 0 replays as fast as possible.
+    bool replay(fs::FS &fs, const String &path, ThingClient &client, float speed, TraceReplayStats &stats);
+};
+
+#endif //AWSTRACE_H
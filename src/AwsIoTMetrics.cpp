@@ -0,0 +1,151 @@
+#include "AwsIoTMetrics.h"
+
+const char *routeClassName(AwsRouteClass route) {
+    switch (route) {
+        case ROUTE_SHADOW:
+            return "shadow";
+        case ROUTE_JOB:
+            return "job";
+        case ROUTE_COMMAND:
+            return "command";
+        case ROUTE_CUSTOM:
+            return "custom";
+        default:
+            return "unknown";
+    }
+}
+
+void AwsLatencyHistogram::record(uint32_t micros) {
+    size_t bucket = micros == 0 ? 0 : 32 - __builtin_clz(micros);
+    if (bucket >= AWS_METRICS_HISTOGRAM_BUCKETS) {
+        bucket = AWS_METRICS_HISTOGRAM_BUCKETS - 1;
+    }
+
+    this->buckets[bucket]++;
+    this->count++;
+    this->totalMicros += micros;
+    if (micros > this->maxMicros) {
+        this->maxMicros = micros;
+    }
+}
+
+void AwsLatencyHistogram::reset() {
+    memset(this->buckets, 0, sizeof(this->buckets));
+    this->count = 0;
+    this->maxMicros = 0;
+    this->totalMicros = 0;
+}
+
+void AwsLatencyHistogram::toJson(JsonObject out, bool withBuckets) const {
+    out["count"] = this->count;
+    out["max"] = this->maxMicros;
+    out["avg"] = this->count > 0 ? (uint32_t) (this->totalMicros / this->count) : 0;
+
+    if (withBuckets) {
+        JsonObject buckets = out["buckets"].to<JsonObject>();
+        for (size_t bucket = 0; bucket < AWS_METRICS_HISTOGRAM_BUCKETS; bucket++) {
+            if (this->buckets[bucket] > 0) {
+                buckets[String((unsigned int) bucket)] = this->buckets[bucket];
+            }
+        }
+    }
+}
+
+void AwsHeapStats::sample() {
+#if defined(ESP32)
+    this->freeHeap = ESP.getFreeHeap();
+    this->largestFreeBlock = ESP.getMaxAllocHeap();
+    // The allocator's own low watermark also catches dips between two samples. It covers the time since boot
+    // and cannot be reset.
+    this->lowestFreeHeap = ESP.getMinFreeHeap();
+#elif defined(ESP8266)
+    this->freeHeap = ESP.getFreeHeap();
+    this->largestFreeBlock = ESP.getMaxFreeBlockSize();
+    if (this->lowestFreeHeap == 0 || this->freeHeap < this->lowestFreeHeap) {
+        this->lowestFreeHeap = this->freeHeap;
+    }
+#endif
+}
+
+void AwsHeapStats::reset() {
+    this->freeHeap = 0;
+    this->lowestFreeHeap = 0;
+    this->largestFreeBlock = 0;
+}
+
+void AwsHeapStats::toJson(JsonObject out) const {
+    out["free"] = this->freeHeap;
+    out["lowest"] = this->lowestFreeHeap;
+    out["largestBlock"] = this->largestFreeBlock;
+}
+
+void AwsRouteMetrics::recordInbound(size_t bytes, uint32_t micros) {
+    this->messagesIn++;
+    this->bytesIn += bytes;
+    this->handlerMicros.record(micros);
+}
+
+void AwsRouteMetrics::recordOutbound(size_t bytes) {
+    this->messagesOut++;
+    this->bytesOut += bytes;
+}
+
+bool AwsRouteMetrics::isEmpty() const {
+    return this->messagesIn == 0 && this->messagesOut == 0;
+}
+
+void AwsRouteMetrics::reset() {
+    this->messagesIn = 0;
+    this->bytesIn = 0;
+    this->messagesOut = 0;
+    this->bytesOut = 0;
+    this->handlerMicros.reset();
+}
+
+void AwsRouteMetrics::toJson(JsonObject out, bool withBuckets) const {
+    out["in"] = this->messagesIn;
+    out["bytesIn"] = this->bytesIn;
+    out["out"] = this->messagesOut;
+    out["bytesOut"] = this->bytesOut;
+    if (this->handlerMicros.count > 0) {
+        this->handlerMicros.toJson(out["handler"].to<JsonObject>(), withBuckets);
+    }
+}
+
+void ThingClientMetrics::reset() {
+    for (AwsRouteMetrics &route: this->routes) {
+        route.reset();
+    }
+    this->unhandledMessages = 0;
+    this->publishFailures = 0;
+    this->rejectedResponses = 0;
+    this->retries = 0;
+    this->heap.reset();
+}
+
+void ThingClientMetrics::toJson(JsonObject out, bool withBuckets) const {
+    for (size_t route = 0; route < ROUTE_CLASS_COUNT; route++) {
+        if (!this->routes[route].isEmpty()) {
+            this->routes[route].toJson(out[routeClassName((AwsRouteClass) route)].to<JsonObject>(), withBuckets);
+        }
+    }
+    out["unhandled"] = this->unhandledMessages;
+    out["publishFailures"] = this->publishFailures;
+    out["rejected"] = this->rejectedResponses;
+    out["retries"] = this->retries;
+    this->heap.toJson(out["heap"].to<JsonObject>());
+}
+
+void FleetProvisioningMetrics::reset() {
+    this->messagesIn = 0;
+    this->bytesIn = 0;
+    this->publishFailures = 0;
+    this->rejectedResponses = 0;
+}
+
+void FleetProvisioningMetrics::toJson(JsonObject out) const {
+    out["in"] = this->messagesIn;
+    out["bytesIn"] = this->bytesIn;
+    out["publishFailures"] = this->publishFailures;
+    out["rejected"] = this->rejectedResponses;
+}
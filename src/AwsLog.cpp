@@ -0,0 +1,222 @@
+#include "AwsLog.h"
+
+#define AWS_LOG_LINE_SIZE 192
+
+#ifdef AWS_IOT_DEFERRED_LOG
+AwsLogRing AwsLog;
+#endif
+
+static const char *levelName(AwsLogLevel level) {
+    switch (level) {
+        case AWS_LOG_LEVEL_ERROR:
+            return "ERROR";
+        case AWS_LOG_LEVEL_INFO:
+            return "INFO";
+        case AWS_LOG_LEVEL_DEBUG:
+            return "DEBUG";
+        case AWS_LOG_LEVEL_TRACE:
+            return "TRACE";
+        default:
+            return "NONE";
+    }
+}
+
+AwsLogRing::AwsLogRing() : head(0), tail(0), dropped(0) {
+    this->reportedDropped = 0;
+    this->output = &Serial;
+    this->drainBudget = 4;
+
+#if defined(LOG_TRACE)
+    this->level = AWS_LOG_LEVEL_TRACE;
+#elif defined(LOG_DEBUG)
+    this->level = AWS_LOG_LEVEL_DEBUG;
+#elif defined(LOG_INFO)
+    this->level = AWS_LOG_LEVEL_INFO;
+#else
+    this->level = AWS_LOG_LEVEL_NONE;
+#endif
+}
+
+void AwsLogRing::setLevel(AwsLogLevel level) {
+    this->level = level;
+}
+
+AwsLogLevel AwsLogRing::getLevel() const {
+    return this->level;
+}
+
+void AwsLogRing::setOutput(Print *output, size_t drainBudget) {
+    this->output = output;
+    this->drainBudget = drainBudget;
+}
+
+uint32_t AwsLogRing::getDropped() const {
+    return this->dropped.load(std::memory_order_relaxed);
+}
+
+void AwsLogRing::encodeArg(AwsLogRecord &record, const char *arg) {
+    if (arg == nullptr) {
+        arg = "(null)";
+    }
+
+    if (record.textLength >= AWS_LOG_TEXT_SIZE) {
+        return;
+    }
+
+    size_t length = strnlen(arg, AWS_LOG_TEXT_SIZE - record.textLength - 1);
+    memcpy(record.text + record.textLength, arg, length);
+    record.text[record.textLength + length] = '\0';
+    record.textLength += length + 1;
+}
+
+void AwsLogRing::encodeArg(AwsLogRecord &record, const String &arg) {
+    encodeArg(record, arg.c_str());
+}
+
+void AwsLogRing::encodeArg(AwsLogRecord &record, unsigned long arg) {
+    if (record.argc < AWS_LOG_MAX_ARGS) {
+        record.args[record.argc++] = (uint32_t) arg;
+    }
+}
+
+AwsLogRecord *AwsLogRing::reserve() {
+    uint32_t h = this->head.load(std::memory_order_relaxed);
+    uint32_t t = this->tail.load(std::memory_order_acquire);
+
+    if (h - t >= AWS_LOG_RING_SIZE) {
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    return &this->records[h & (AWS_LOG_RING_SIZE - 1)];
+}
+
+void AwsLogRing::commit() {
+    uint32_t h = this->head.load(std::memory_order_relaxed);
+    this->head.store(h + 1, std::memory_order_release);
+}
+
+bool AwsLogRing::read(AwsLogRecord &record) {
+    uint32_t t = this->tail.load(std::memory_order_relaxed);
+    uint32_t h = this->head.load(std::memory_order_acquire);
+
+    if (t == h) {
+        return false;
+    }
+
+    record = this->records[t & (AWS_LOG_RING_SIZE - 1)];
+    this->tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+size_t AwsLogRing::format(const AwsLogRecord &record, char *buffer, size_t size) const {
+    if (size == 0) {
+        return 0;
+    }
+
+    size_t written = 0;
+    size_t nextArg = 0;
+    size_t nextText = 0;
+    const char *cursor = record.format;
+
+    // Walk the format string and hand each conversion to snprintf on its own with the argument type it expects.
+    while (*cursor != '\0' && written < size - 1) {
+        if (*cursor != '%') {
+            buffer[written++] = *cursor++;
+            continue;
+        }
+
+        if (cursor[1] == '%') {
+            buffer[written++] = '%';
+            cursor += 2;
+            continue;
+        }
+
+        // Flags, width, precision and the h / l length modifiers are passed on to snprintf. The other length
+        // modifiers (ll, j, z, t, L) and a * width need arguments the record does not store, those conversions
+        // print "?", as does anything that is not an integer, character or string conversion.
+        char spec[16];
+        size_t specLength = 0;
+        size_t longModifiers = 0;
+        size_t starArgs = 0;
+        bool isSupported = true;
+
+        spec[specLength++] = *cursor++;
+        while (*cursor != '\0' && strchr("-+ #0123456789.hl*jztL", *cursor) != nullptr) {
+            longModifiers += *cursor == 'l';
+            starArgs += *cursor == '*';
+            isSupported &= strchr("*jztL", *cursor) == nullptr && specLength < sizeof(spec) - 2;
+            if (specLength < sizeof(spec) - 2) {
+                spec[specLength++] = *cursor;
+            }
+            cursor++;
+        }
+        if (*cursor == '\0') {
+            break;
+        }
+
+        char conversion = *cursor++;
+        spec[specLength++] = conversion;
+        spec[specLength] = '\0';
+
+        bool isString = conversion == 's';
+        bool isInteger = strchr("diouxXc", conversion) != nullptr;
+        isSupported &= longModifiers <= (conversion == 's' || conversion == 'c' ? 0u : 1u);
+
+        const char *text = "";
+        if (isString) {
+            text = nextText < record.textLength ? record.text + nextText : "";
+            nextText += strlen(text) + 1;
+        }
+
+        int result;
+        if (isString && isSupported) {
+            result = snprintf(buffer + written, size - written, spec, text);
+        } else if (!isInteger || !isSupported || nextArg >= record.argc) {
+            // A refused conversion still uses up its arguments, so the ones after it stay in place.
+            nextArg += starArgs + isInteger;
+            result = snprintf(buffer + written, size - written, "%s", "?");
+        } else if (longModifiers > 0) {
+            // Arguments are stored as 32 bits, sign extend them again where long is wider.
+            uint32_t arg = record.args[nextArg++];
+            result = conversion == 'd' || conversion == 'i'
+                         ? snprintf(buffer + written, size - written, spec, (long) (int32_t) arg)
+                         : snprintf(buffer + written, size - written, spec, (unsigned long) arg);
+        } else {
+            result = snprintf(buffer + written, size - written, spec, (unsigned int) record.args[nextArg++]);
+        }
+
+        if (result > 0) {
+            written += (size_t) result < size - written ? (size_t) result : size - written - 1;
+        }
+    }
+
+    buffer[written] = '\0';
+    return written;
+}
+
+size_t AwsLogRing::drain(Print &out, size_t maxRecords) {
+    AwsLogRecord record;
+    char line[AWS_LOG_LINE_SIZE];
+    size_t drained = 0;
+
+    uint32_t dropped = this->dropped.load(std::memory_order_relaxed);
+    if (dropped != this->reportedDropped) {
+        out.printf("[WARN] %u log records dropped\n", (unsigned int) (dropped - this->reportedDropped));
+        this->reportedDropped = dropped;
+    }
+
+    while (drained < maxRecords && read(record)) {
+        format(record, line, sizeof(line));
+        out.printf("[%s] %lu: %s\n", levelName(record.level), (unsigned long) record.timestamp, line);
+        drained++;
+    }
+
+    return drained;
+}
+
+void AwsLogRing::loop() {
+    if (this->output != nullptr) {
+        drain(*this->output, this->drainBudget);
+    }
+}
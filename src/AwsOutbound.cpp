@@ -0,0 +1,186 @@
+#include "AwsOutbound.h"
+#include "AwsLog.h"
+
+void AwsTokenBucket::configure(uint16_t perSecond, uint16_t burst) {
+    this->rate = perSecond;
+    this->capacity = (uint32_t) (burst > 0 ? burst : 1) * 1000;
+    this->level = this->capacity;
+    this->refilledAt = millis();
+}
+
+bool AwsTokenBucket::available(unsigned long now) {
+    if (this->rate == 0) {
+        return true;
+    }
+
+    unsigned long elapsed = now - this->refilledAt;
+    if (elapsed > 0) {
+        // Cap the elapsed time so the multiplication cannot overflow after a long idle period.
+        unsigned long refillTime = this->capacity / this->rate + 1;
+        if (elapsed > refillTime) {
+            elapsed = refillTime;
+        }
+
+        this->level += elapsed * this->rate;
+        if (this->level > this->capacity) {
+            this->level = this->capacity;
+        }
+        this->refilledAt = now;
+    }
+
+    return this->level >= 1000;
+}
+
+void AwsTokenBucket::take() {
+    if (this->rate > 0) {
+        this->level -= 1000;
+    }
+}
+
+OutboundScheduler::OutboundScheduler(PubSubClient *client) {
+    this->client = client;
+    this->connectionBucket.configure(AWS_OUTBOUND_CONNECTION_RATE, AWS_OUTBOUND_CONNECTION_RATE);
+
+    for (Lane &lane: this->lanes) {
+        lane.bucket.configure(0, 0);
+        lane.dropPolicy = DROP_NEWEST;
+        lane.head = 0;
+        lane.count = 0;
+        lane.stats = {};
+    }
+}
+
+void OutboundScheduler::setRate(AwsPublishLane lane, uint16_t perSecond, uint16_t burst) {
+    this->lanes[lane].bucket.configure(perSecond, burst);
+}
+
+void OutboundScheduler::setConnectionRate(uint16_t perSecond, uint16_t burst) {
+    this->connectionBucket.configure(perSecond, burst);
+}
+
+void OutboundScheduler::setDropPolicy(AwsPublishLane lane, AwsDropPolicy dropPolicy) {
+    this->lanes[lane].dropPolicy = dropPolicy;
+}
+
+void OutboundScheduler::setOutcomeCallback(AwsOutboundCallback callback) {
+    this->outcomeCallback = callback;
+}
+
+void OutboundScheduler::report(AwsPublishLane lane, const String &topic, const String &payload, bool published) {
+    if (this->outcomeCallback) {
+        this->outcomeCallback(lane, topic.length() + payload.length(), published);
+    }
+}
+
+bool OutboundScheduler::canSend(Lane &lane, unsigned long now) {
+    return this->connectionBucket.available(now) && lane.bucket.available(now);
+}
+
+bool OutboundScheduler::send(Lane &lane, const String &topic, const String &payload) {
+    this->connectionBucket.take();
+    lane.bucket.take();
+
+    if (this->client->publish(topic.c_str(), payload.c_str())) {
+        lane.stats.published++;
+        return true;
+    }
+
+    lane.stats.failed++;
+    AWS_LOG_DEBUG("Publish to %s failed.", topic.c_str());
+    return false;
+}
+
+bool OutboundScheduler::enqueue(AwsPublishLane index, const String &topic, const String &payload) {
+    Lane &lane = this->lanes[index];
+
+    if (lane.count == AWS_OUTBOUND_QUEUE_SIZE) {
+        lane.stats.dropped++;
+        if (lane.dropPolicy == DROP_NEWEST) {
+            report(index, topic, payload, false);
+            return false;
+        }
+
+        AwsOutboundMessage &evicted = lane.queue[lane.head];
+        report(index, evicted.topic, evicted.payload, false);
+        lane.head = (lane.head + 1) % AWS_OUTBOUND_QUEUE_SIZE;
+        lane.count--;
+    }
+
+    AwsOutboundMessage &message = lane.queue[(lane.head + lane.count) % AWS_OUTBOUND_QUEUE_SIZE];
+    message.topic = topic;
+    message.payload = payload;
+
+    lane.count++;
+    lane.stats.queued++;
+    if (lane.count > lane.stats.highWatermark) {
+        lane.stats.highWatermark = lane.count;
+    }
+    return true;
+}
+
+// A lane with queued messages and tokens left is served by loop(). A throttled lane does not hold back the
+// lanes below it, they have their own API limits.
+bool OutboundScheduler::sendable(Lane &lane, unsigned long now) {
+    return lane.count > 0 && lane.bucket.available(now);
+}
+
+bool OutboundScheduler::hasSendableAbove(AwsPublishLane lane, unsigned long now) {
+    for (size_t index = 0; index < lane; index++) {
+        if (sendable(this->lanes[index], now)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool OutboundScheduler::publish(AwsPublishLane lane, const String &topic, const String &payload) {
+    Lane &target = this->lanes[lane];
+    unsigned long now = millis();
+
+    // Same order loop() uses: only bypass the queue when loop() would pick this message next.
+    if (target.count == 0 && this->client->connected() && !hasSendableAbove(lane, now) && canSend(target, now)) {
+        bool published = send(target, topic, payload);
+        report(lane, topic, payload, published);
+        return published;
+    }
+
+    return enqueue(lane, topic, payload);
+}
+
+void OutboundScheduler::loop() {
+    if (!this->client->connected()) {
+        return;
+    }
+
+    unsigned long now = millis();
+
+    for (size_t index = 0; index < LANE_COUNT; index++) {
+        Lane &lane = this->lanes[index];
+
+        while (sendable(lane, now)) {
+            if (!this->connectionBucket.available(now)) {
+                // Nothing else can go out on this connection until the next refill.
+                return;
+            }
+
+            AwsOutboundMessage &message = lane.queue[lane.head];
+            bool published = send(lane, message.topic, message.payload);
+            report((AwsPublishLane) index, message.topic, message.payload, published);
+
+            // Release the strings now, otherwise every slot holds on to its last payload.
+            message.topic = String();
+            message.payload = String();
+            lane.head = (lane.head + 1) % AWS_OUTBOUND_QUEUE_SIZE;
+            lane.count--;
+        }
+    }
+}
+
+size_t OutboundScheduler::pending(AwsPublishLane lane) const {
+    return this->lanes[lane].count;
+}
+
+const AwsLaneStats &OutboundScheduler::getStats(AwsPublishLane lane) const {
+    return this->lanes[lane].stats;
+}
@@ -0,0 +1,386 @@
+#include "AwsTrace.h"
+#include "AwsLog.h"
+
+#include <cstddef>
+
+static const uint8_t TRACE_MAGIC[4] = {'A', 'W', 'T', 'R'};
+
+static void putUInt(uint8_t *out, uint32_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        out[i] = (uint8_t) (value >> (8 * i));
+    }
+}
+
+static bool readUInt(File &file, uint32_t &value, size_t bytes) {
+    uint8_t raw[4];
+    if (file.readBytes((char *) raw, bytes) != bytes) {
+        return false;
+    }
+
+    value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint32_t) raw[i] << (8 * i);
+    }
+    return true;
+}
+
+static uint32_t freeHeap() {
+#if defined(ESP32) || defined(ESP8266)
+    return ESP.getFreeHeap();
+#else
+    return 0;
+#endif
+}
+
+// micros() wraps after about 71 minutes, the replay clock adds up its deltas in 64 bits instead.
+static uint64_t advanceClock(unsigned long &clockAt, uint64_t &elapsed) {
+    unsigned long now = micros();
+    elapsed += now - clockAt;
+    clockAt = now;
+    return elapsed;
+}
+
+TraceRecorder::TraceRecorder() {
+    this->isRecording = false;
+    this->startedAt = 0;
+    this->flushedAt = 0;
+    this->records = 0;
+    this->failedRecords = 0;
+    this->buffered = 0;
+    this->bufferedRecords = 0;
+}
+
+bool TraceRecorder::begin(fs::FS &fs, const String &path) {
+    this->file = fs.open(path, FILE_WRITE, true);
+    if (!this->file) {
+        AWS_LOG_DEBUG("Failed to open trace file for writing");
+        return false;
+    }
+
+    uint8_t header[sizeof(TRACE_MAGIC) + 1];
+    memcpy(header, TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    header[sizeof(TRACE_MAGIC)] = AWS_TRACE_VERSION;
+    if (this->file.write(header, sizeof(header)) != sizeof(header)) {
+        AWS_LOG_DEBUG("Failed to write trace file header");
+        this->file.close();
+        return false;
+    }
+
+    this->isRecording = true;
+    this->startedAt = millis();
+    this->flushedAt = this->startedAt;
+    this->records = 0;
+    this->failedRecords = 0;
+    this->buffered = 0;
+    this->bufferedRecords = 0;
+    AWS_LOG_INFO("Trace recording started: %s", path.c_str());
+    return true;
+}
+
+void TraceRecorder::end() {
+    if (this->isRecording) {
+        flush();
+        this->isRecording = false;
+        this->file.close();
+        AWS_LOG_INFO("Trace recording stopped after %u messages, %u failed",
+                     (unsigned int) this->records, (unsigned int) this->failedRecords);
+    }
+}
+
+bool TraceRecorder::stage(const String &topic, JsonDocument &payload) {
+    size_t topicLength = topic.length();
+    size_t room = AWS_TRACE_BUFFER_SIZE - this->buffered;
+    if (topicLength > 0xffff || room <= AWS_TRACE_RECORD_HEADER_SIZE + topicLength) {
+        return false;
+    }
+
+    uint8_t *record = this->buffer + this->buffered;
+    size_t payloadRoom = room - AWS_TRACE_RECORD_HEADER_SIZE - topicLength;
+    size_t payloadLength = serializeMsgPack(payload, record + AWS_TRACE_RECORD_HEADER_SIZE + topicLength, payloadRoom);
+    // The serializer stops silently at the end of the buffer, so a payload that fills it may have been cut short.
+    if (payloadLength == 0 || payloadLength >= payloadRoom) {
+        return false;
+    }
+
+    putUInt(record, millis() - this->startedAt, 4);
+    putUInt(record + 4, topicLength, 2);
+    putUInt(record + 6, payloadLength, 4);
+    memcpy(record + AWS_TRACE_RECORD_HEADER_SIZE, topic.c_str(), topicLength);
+
+    this->buffered += AWS_TRACE_RECORD_HEADER_SIZE + topicLength + payloadLength;
+    this->bufferedRecords++;
+    return true;
+}
+
+bool TraceRecorder::record(const String &topic, JsonDocument &payload) {
+    if (!this->isRecording) {
+        return false;
+    }
+
+    if (stage(topic, payload)) {
+        return true;
+    }
+
+    // Out of buffer space: write out what is staged and try once more with the whole buffer.
+    if (this->buffered > 0 && flush() && stage(topic, payload)) {
+        return true;
+    }
+
+    this->failedRecords++;
+    return false;
+}
+
+bool TraceRecorder::flush() {
+    if (!this->isRecording) {
+        return false;
+    }
+
+    this->flushedAt = millis();
+    if (this->buffered == 0) {
+        return true;
+    }
+
+    bool written = this->file.write(this->buffer, this->buffered) == this->buffered;
+    if (written) {
+        this->records += this->bufferedRecords;
+        this->file.flush();
+    } else {
+        this->failedRecords += this->bufferedRecords;
+    }
+    this->buffered = 0;
+    this->bufferedRecords = 0;
+
+    if (!written) {
+        // Anything appended after a short write would be misaligned, so stop here.
+        AWS_LOG_INFO("Trace write failed, recording stopped after %u messages", (unsigned int) this->records);
+        this->isRecording = false;
+        this->file.close();
+    }
+    return written;
+}
+
+void TraceRecorder::loop() {
+    if (this->isRecording && this->buffered > 0 &&
+        (this->buffered >= AWS_TRACE_BUFFER_SIZE / 2 || millis() - this->flushedAt >= AWS_TRACE_FLUSH_INTERVAL)) {
+        flush();
+    }
+}
+
+uint32_t TraceRecorder::getRecordCount() const {
+    return this->records;
+}
+
+uint32_t TraceRecorder::getFailedCount() const {
+    return this->failedRecords;
+}
+
+// Every block starts with its bin, or the bin count for blocks too large to cache, and its usable size.
+struct TraceBlockHeader {
+    size_t bin;
+    size_t capacity;
+};
+
+static constexpr size_t TRACE_BLOCK_HEADER_SIZE =
+    (sizeof(TraceBlockHeader) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+static constexpr size_t TRACE_SMALLEST_BLOCK = 32;
+
+TraceReplayAllocator::TraceReplayAllocator() {
+    memset(this->bins, 0, sizeof(this->bins));
+}
+
+TraceReplayAllocator::~TraceReplayAllocator() {
+    release();
+}
+
+void *TraceReplayAllocator::allocate(size_t size) {
+    size_t bin = 0;
+    while (bin < AWS_TRACE_ALLOCATOR_BINS && (TRACE_SMALLEST_BLOCK << bin) < size + TRACE_BLOCK_HEADER_SIZE) {
+        bin++;
+    }
+
+    uint8_t *block;
+    if (bin < AWS_TRACE_ALLOCATOR_BINS && this->bins[bin] != nullptr) {
+        block = (uint8_t *) this->bins[bin];
+        memcpy(&this->bins[bin], block + TRACE_BLOCK_HEADER_SIZE, sizeof(void *));
+    } else {
+        size_t blockSize = bin < AWS_TRACE_ALLOCATOR_BINS ? TRACE_SMALLEST_BLOCK << bin : size + TRACE_BLOCK_HEADER_SIZE;
+        block = (uint8_t *) malloc(blockSize);
+        if (block == nullptr) {
+            return nullptr;
+        }
+        auto *header = (TraceBlockHeader *) block;
+        header->bin = bin;
+        header->capacity = blockSize - TRACE_BLOCK_HEADER_SIZE;
+    }
+    return block + TRACE_BLOCK_HEADER_SIZE;
+}
+
+void TraceReplayAllocator::deallocate(void *pointer) {
+    if (pointer == nullptr) {
+        return;
+    }
+
+    uint8_t *block = (uint8_t *) pointer - TRACE_BLOCK_HEADER_SIZE;
+    size_t bin = ((TraceBlockHeader *) block)->bin;
+    if (bin >= AWS_TRACE_ALLOCATOR_BINS) {
+        free(block);
+        return;
+    }
+
+    // The free list link lives in the block's own payload.
+    memcpy(pointer, &this->bins[bin], sizeof(void *));
+    this->bins[bin] = block;
+}
+
+void *TraceReplayAllocator::reallocate(void *pointer, size_t new_size) {
+    if (pointer == nullptr) {
+        return allocate(new_size);
+    }
+
+    size_t capacity = ((TraceBlockHeader *) ((uint8_t *) pointer - TRACE_BLOCK_HEADER_SIZE))->capacity;
+    if (new_size <= capacity) {
+        return pointer;
+    }
+
+    void *grown = allocate(new_size);
+    if (grown != nullptr) {
+        memcpy(grown, pointer, capacity);
+        deallocate(pointer);
+    }
+    return grown;
+}
+
+void TraceReplayAllocator::release() {
+    for (void *&bin: this->bins) {
+        while (bin != nullptr) {
+            auto *block = (uint8_t *) bin;
+            memcpy(&bin, block + TRACE_BLOCK_HEADER_SIZE, sizeof(void *));
+            free(block);
+        }
+    }
+}
+
+TraceReplayer::TraceReplayer() {
+    this->buffer = nullptr;
+    this->bufferSize = 0;
+    this->topic.reserve(AWS_TRACE_TOPIC_RESERVE);
+}
+
+TraceReplayer::~TraceReplayer() {
+    free(this->buffer);
+}
+
+bool TraceReplayer::readInto(File &file, size_t length) {
+    // length + 1 would wrap and skip the resize.
+    if (length == SIZE_MAX) {
+        return false;
+    }
+
+    if (length + 1 > this->bufferSize) {
+        auto *grown = (uint8_t *) realloc(this->buffer, length + 1);
+        if (grown == nullptr) {
+            return false;
+        }
+        this->buffer = grown;
+        this->bufferSize = length + 1;
+    }
+
+    if (file.readBytes((char *) this->buffer, length) != length) {
+        return false;
+    }
+
+    this->buffer[length] = '\0';
+    return true;
+}
+
+bool TraceReplayer::replay(fs::FS &fs, const String &path, ThingClient &client, float speed,
+                           TraceReplayStats &stats) {
+    stats = {};
+
+    File file = fs.open(path, FILE_READ);
+    if (!file) {
+        AWS_LOG_DEBUG("Trace file not found");
+        return false;
+    }
+
+    uint8_t magic[sizeof(TRACE_MAGIC)];
+    uint32_t version;
+    if (file.readBytes((char *) magic, sizeof(magic)) != sizeof(magic)
+        || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0
+        || !readUInt(file, version, 1) || version != AWS_TRACE_VERSION) {
+        AWS_LOG_DEBUG("Trace file has an unknown format");
+        file.close();
+        return false;
+    }
+
+    // The read buffer, the topic string and the document's blocks are all reused from record to record,
+    // so once the largest record has been seen the replay itself stops allocating.
+    JsonDocument payload(&this->allocator);
+    uint32_t offset, topicLength, payloadLength;
+
+    stats.heapBefore = freeHeap();
+    stats.heapLowest = stats.heapBefore;
+    unsigned long clockAt = micros();
+    uint64_t elapsed = 0;
+
+    while (readUInt(file, offset, 4) && readUInt(file, topicLength, 2) && readUInt(file, payloadLength, 4)) {
+        // A corrupt length would otherwise size the read buffer to whatever garbage it holds. The lengths are
+        // checked one at a time, their sum can wrap.
+        int available = file.available();
+        if (available < 0 || topicLength > (uint32_t) available || payloadLength > (uint32_t) available - topicLength) {
+            stats.errors++;
+            break;
+        }
+
+        if (!readInto(file, topicLength)) {
+            stats.errors++;
+            break;
+        }
+        this->topic = "";
+        this->topic.concat((const char *) this->buffer, topicLength);
+
+        if (!readInto(file, payloadLength)) {
+            stats.errors++;
+            break;
+        }
+
+        if (deserializeMsgPack(payload, this->buffer, payloadLength)) {
+            stats.errors++;
+            continue;
+        }
+
+        if (speed > 0) {
+            auto dueAt = (uint64_t) (offset * 1000.0 / speed);
+            while (advanceClock(clockAt, elapsed) < dueAt) {
+                yield();
+            }
+        }
+
+        unsigned long dispatchedAt = micros();
+        if (client.onMessage(this->topic, payload, payloadLength)) {
+            stats.handled++;
+        }
+        stats.dispatchMicros.record(micros() - dispatchedAt);
+        stats.messages++;
+        advanceClock(clockAt, elapsed);
+
+        uint32_t heap = freeHeap();
+        if (heap < stats.heapLowest) {
+            stats.heapLowest = heap;
+        }
+    }
+
+    stats.elapsedMicros = advanceClock(clockAt, elapsed);
+    stats.heapAfter = freeHeap();
+    file.close();
+
+    AWS_LOG_INFO("Replayed %u messages (%u handled) in %lu ms", (unsigned int) stats.messages,
+                 (unsigned int) stats.handled, (unsigned long) (stats.elapsedMicros / 1000));
+    AWS_LOG_INFO("Dispatch avg %lu us, max %u us",
+                 stats.messages > 0 ? (unsigned long) (stats.dispatchMicros.totalMicros / stats.messages) : 0UL,
+                 (unsigned int) stats.dispatchMicros.maxMicros);
+    AWS_LOG_INFO("Free heap before %u, after %u, lowest %u",
+                 (unsigned int) stats.heapBefore, (unsigned int) stats.heapAfter, (unsigned int) stats.heapLowest);
+    return true;
+}
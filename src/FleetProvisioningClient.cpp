@@ -9,15 +9,31 @@
 #include <LittleFS.h>
 #include <FS.h>
 
+#define KEYSTORE_DIR "/tmp"
 #define KEYSTORE_FILE "/tmp/aws-keystore.json"
 
+#define CERTIFICATES_CREATE_TOPIC "$aws/certificates/create/json"
+#define CERTIFICATES_CREATE_ACCEPTED_TOPIC "$aws/certificates/create/json/accepted"
+#define CERTIFICATES_CREATE_REJECTED_TOPIC "$aws/certificates/create/json/rejected"
+
 FleetProvisioningClient::FleetProvisioningClient(PubSubClient *client, const String &provisioningName,
-                                                 const String &thingName) {
+                                                 const String &thingName, AwsIoTBuildFlags flags) {
     this->client = client;
     this->provisioningName = provisioningName;
     this->thingName = thingName;
+    this->keystorePath = KEYSTORE_FILE;
     this->isRunning = false;
+    this->phase = PHASE_IDLE;
     this->callback = nullptr;
+    this->timings = {};
+#ifdef AWS_IOT_METRICS
+    this->metrics.reset();
+#endif
+
+    // Topics only depend on the template name, so build them once instead of on every message.
+    this->provisionTopic = "$aws/provisioning-templates/" + provisioningName + "/provision/json";
+    this->provisionAcceptedTopic = this->provisionTopic + "/accepted";
+    this->provisionRejectedTopic = this->provisionTopic + "/rejected";
 
 #ifdef LOG_INFO
     Serial.println(F("[INFO] FleetProvisioningClient initialized"));
@@ -26,7 +42,9 @@ FleetProvisioningClient::FleetProvisioningClient(PubSubClient *client, const Str
 
 void FleetProvisioningClient::begin() {
     this->isRunning = true;
-    bool mkdir = LittleFS.mkdir("/tmp");
+    this->phase = PHASE_AWAITING_CERTIFICATE;
+    this->timings = {};
+    bool mkdir = LittleFS.exists(KEYSTORE_DIR) || LittleFS.mkdir(KEYSTORE_DIR);
 #ifdef LOG_DEBUG
     Serial.println(F("[DEBUG] FleetProvisioningClient starting"));
 #endif
@@ -34,9 +52,14 @@ void FleetProvisioningClient::begin() {
 #ifdef LOG_DEBUG
         Serial.println(F("[DEBUG] Failed to create temporary directory"));
 #endif
+        finish(PROVISIONING_FAILED);
+        return;
+    }
+    this->timings.createRequestedAt = micros();
+    if (!publish(CERTIFICATES_CREATE_TOPIC, "{}")) {
+        finish(PROVISIONING_FAILED);
         return;
     }
-    this->client->publish("$aws/certificates/create/json", "{}");
 #ifdef LOG_INFO
     Serial.println(F("[INFO] Certificate creation request sent"));
 #endif
@@ -56,6 +79,50 @@ void FleetProvisioningClient::setCallback(FleetProvisioningClientCallback callba
 #endif
 }
 
+void FleetProvisioningClient::setCallback(FleetProvisioningClientCallbackFunction callback) {
+    this->callback = callback;
+#ifdef LOG_INFO
+    Serial.println(F("[INFO] Callback set for FleetProvisioningClient"));
+#endif
+}
+
+void FleetProvisioningClient::setKeystorePath(const String &keystorePath) {
+    this->keystorePath = keystorePath;
+}
+
+const FleetProvisioningTimings &FleetProvisioningClient::getTimings() const {
+    return this->timings;
+}
+
+FleetProvisioningPhase FleetProvisioningClient::getPhase() const {
+    return this->phase;
+}
+
+void FleetProvisioningClient::finish(FleetProvisioningOutcome outcome) {
+    this->phase = PHASE_DONE;
+    this->timings.outcome = outcome;
+}
+
+#ifdef AWS_IOT_METRICS
+const FleetProvisioningMetrics &FleetProvisioningClient::getMetrics() const {
+    return this->metrics;
+}
+
+void FleetProvisioningClient::resetMetrics() {
+    this->metrics.reset();
+}
+#endif
+
+bool FleetProvisioningClient::publish(const String &topic, const String &payload) {
+    bool published = this->client->publish(topic.c_str(), payload.c_str());
+#ifdef AWS_IOT_METRICS
+    if (!published) {
+        this->metrics.publishFailures++;
+    }
+#endif
+    return published;
+}
+
 void FleetProvisioningClient::saveCertificate(JsonDocument &payload) {
     JsonDocument doc;
     String buffer;
@@ -67,7 +134,7 @@ void FleetProvisioningClient::saveCertificate(JsonDocument &payload) {
 #ifdef LOG_DEBUG
     Serial.println(F("[DEBUG] Saving certificate to keystore"));
 #endif
-    File keystore = LittleFS.open(KEYSTORE_FILE, FILE_WRITE, true);
+    File keystore = LittleFS.open(this->keystorePath, FILE_WRITE, true);
     if (!keystore) {
 #ifdef LOG_DEBUG
         Serial.println(F("[DEBUG] Failed to open keystore file for writing"));
@@ -84,18 +151,19 @@ void FleetProvisioningClient::saveCertificate(JsonDocument &payload) {
 
 void FleetProvisioningClient::requestProvisioning(JsonDocument &payload) {
     JsonDocument doc;
-    char provisioningTopic[256];
     String buffer;
 
     doc["certificateOwnershipToken"] = payload["certificateOwnershipToken"].as<const char *>();
     doc["parameters"]["ThingName"] = this->thingName;
     doc["parameters"]["AWS::IoT::Certificate::Id"] = payload["certificateId"].as<const char *>();
 
-    snprintf(provisioningTopic, sizeof(provisioningTopic),
-             "$aws/provisioning-templates/%s/provision/json", this->provisioningName.c_str());
-
     serializeJson(doc, buffer);
-    this->client->publish(provisioningTopic, buffer.c_str());
+    this->timings.provisionRequestedAt = micros();
+    if (!publish(this->provisionTopic, buffer)) {
+        finish(PROVISIONING_FAILED);
+        return;
+    }
+    this->phase = PHASE_AWAITING_REGISTRATION;
 #ifdef LOG_INFO
     Serial.println(F("[INFO] Provisioning request sent"));
 #endif
@@ -105,7 +173,7 @@ bool FleetProvisioningClient::acceptProvisioning(JsonDocument &payload) {
     String content;
     JsonDocument reply;
 
-    File keystore = LittleFS.open(KEYSTORE_FILE, "r");
+    File keystore = LittleFS.open(this->keystorePath, "r");
 #ifdef LOG_DEBUG
     Serial.println(F("[DEBUG] Reading keystore file"));
 #endif
@@ -123,12 +191,13 @@ bool FleetProvisioningClient::acceptProvisioning(JsonDocument &payload) {
 #ifdef LOG_DEBUG
         Serial.println(F("[DEBUG] Failed to deserialize keystore file"));
 #endif
-        LittleFS.remove(KEYSTORE_FILE);
+        LittleFS.remove(this->keystorePath);
         return false;
     }
 
     if (this->callback != nullptr && this->callback(F("provisioning/success"), reply)) {
-        LittleFS.remove(KEYSTORE_FILE);
+        LittleFS.remove(this->keystorePath);
+        this->timings.completedAt = micros();
 #ifdef LOG_INFO
         Serial.println(F("[INFO] Provisioning accepted"));
 #endif
@@ -138,7 +207,7 @@ bool FleetProvisioningClient::acceptProvisioning(JsonDocument &payload) {
     return false;
 }
 
-bool FleetProvisioningClient::onMessage(const String &topic, JsonDocument &payload) {
+bool FleetProvisioningClient::onMessage(const String &topic, JsonDocument &payload, unsigned int length) {
     if (!this->isRunning) {
 #ifdef LOG_DEBUG
         Serial.println(F("[DEBUG] Received message while client is not running"));
@@ -146,34 +215,58 @@ bool FleetProvisioningClient::onMessage(const String &topic, JsonDocument &paylo
         return false;
     }
 
-    char provisioningTopicAccepted[256], provisioningTopicRejected[256];
-    snprintf(provisioningTopicAccepted, sizeof(provisioningTopicAccepted),
-             "$aws/provisioning-templates/%s/provision/json/accepted", this->provisioningName.c_str());
-    snprintf(provisioningTopicRejected, sizeof(provisioningTopicRejected),
-             "$aws/provisioning-templates/%s/provision/json/rejected", this->provisioningName.c_str());
+#ifdef AWS_IOT_METRICS
+    this->metrics.messagesIn++;
+    this->metrics.bytesIn += topic.length() + length;
+#endif
 
-    if (topic.equals("$aws/certificates/create/json/accepted")) {
+    // Responses for a phase this client is not waiting in belong to another run, leave them alone.
+    if (this->phase == PHASE_AWAITING_CERTIFICATE) {
+        if (topic.equals(CERTIFICATES_CREATE_ACCEPTED_TOPIC)) {
 #ifdef LOG_INFO
-        Serial.println(F("[INFO] Certificate creation accepted"));
+            Serial.println(F("[INFO] Certificate creation accepted"));
 #endif
-        saveCertificate(payload);
-        requestProvisioning(payload);
-        return true;
+            this->timings.createAcceptedAt = micros();
+            saveCertificate(payload);
+            requestProvisioning(payload);
+            return true;
+        }
+
+        if (topic.equals(CERTIFICATES_CREATE_REJECTED_TOPIC)) {
+#ifdef LOG_DEBUG
+            Serial.println(F("[DEBUG] Certificate creation rejected"));
+#endif
+#ifdef AWS_IOT_METRICS
+            this->metrics.rejectedResponses++;
+#endif
+            finish(PROVISIONING_REJECTED);
+            return true;
+        }
     }
 
-    if (topic.equals(provisioningTopicAccepted)) {
+    if (this->phase == PHASE_AWAITING_REGISTRATION) {
+        if (topic.equals(this->provisionAcceptedTopic)) {
 #ifdef LOG_INFO
-        Serial.println(F("[INFO] Provisioning accepted message received"));
+            Serial.println(F("[INFO] Provisioning accepted message received"));
 #endif
-        return acceptProvisioning(payload);
-    }
+            this->timings.provisionRespondedAt = micros();
+            bool accepted = acceptProvisioning(payload);
+            finish(accepted ? PROVISIONING_SUCCEEDED : PROVISIONING_FAILED);
+            return accepted;
+        }
 
-    if (topic.equals(provisioningTopicRejected)) {
+        if (topic.equals(this->provisionRejectedTopic)) {
 #ifdef LOG_DEBUG
-        Serial.println(F("[DEBUG] Provisioning rejected"));
+            Serial.println(F("[DEBUG] Provisioning rejected"));
 #endif
-        LittleFS.remove(KEYSTORE_FILE);
-        return true;
+            this->timings.provisionRespondedAt = micros();
+#ifdef AWS_IOT_METRICS
+            this->metrics.rejectedResponses++;
+#endif
+            LittleFS.remove(this->keystorePath);
+            finish(PROVISIONING_REJECTED);
+            return true;
+        }
     }
 
     return false;
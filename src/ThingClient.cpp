@@ -6,35 +6,90 @@
 // ReSharper disable CppMemberFunctionMayBeConst
 #include "AwsIoTCore.h"
 #include "aws_utils.h"
+#include "AwsLog.h"
+#include "AwsTrace.h"
+#include "AwsOutbound.h"
 
 #include <LittleFS.h>
 
-ThingClient::ThingClient(PubSubClient *client, const String &thingName) {
+// Topic suffixes are fixed by AWS IoT, their lengths are compile time constants rather than magic offsets.
+#define TOPIC_SUFFIX_LENGTH(suffix) (sizeof(suffix) - 1)
+
+static constexpr char GET_SUFFIX[] = "/get";
+static constexpr char UPDATE_SUFFIX[] = "/update";
+static constexpr char GET_ACCEPTED_SUFFIX[] = "/get/accepted";
+static constexpr char GET_REJECTED_SUFFIX[] = "/get/rejected";
+static constexpr char UPDATE_ACCEPTED_SUFFIX[] = "/update/accepted";
+static constexpr char UPDATE_REJECTED_SUFFIX[] = "/update/rejected";
+static constexpr char UPDATE_DELTA_SUFFIX[] = "/update/delta";
+static constexpr char UPDATE_DOCUMENTS_SUFFIX[] = "/update/documents";
+
+#ifndef AWS_IOT_DISABLE_JOBS
+static constexpr char JOBS_GET_SUFFIX[] = "/jobs/get";
+static constexpr char JOBS_GET_ACCEPTED_SUFFIX[] = "/jobs/get/accepted";
+static constexpr char JOBS_START_NEXT_SUFFIX[] = "/jobs/start-next";
+static constexpr char JOBS_START_NEXT_ACCEPTED_SUFFIX[] = "/jobs/start-next/accepted";
+static constexpr char JOBS_NOTIFY_SUFFIX[] = "/jobs/notify";
+static constexpr char JOBS_ANY_GET_ACCEPTED_SUFFIX[] = "/jobs/+/get/accepted";
+#endif
+
+#ifndef AWS_IOT_DISABLE_COMMANDS
+static constexpr char COMMAND_REQUEST_SUFFIX[] = "/request/json";
+static constexpr char COMMAND_RESPONSE_SUFFIX[] = "/response/json";
+#endif
+
+ThingClient::ThingClient(PubSubClient *client, const String &thingName, AwsIoTBuildFlags flags) {
     this->client = client;
     this->thingName = thingName;
     this->isRunning = false;
+    this->isClassicReceived = false;
     this->callback = nullptr;
     this->shadowCallback = nullptr;
+    this->traceRecorder = nullptr;
+    this->outboundScheduler = nullptr;
+
+    // Every topic is derived from the thing name, format the common prefixes once.
+    this->thingTopic = "$aws/things/" + thingName;
+    this->shadowPrefix = this->thingTopic + "/shadow/name/";
+#ifndef AWS_IOT_DISABLE_JOBS
+    this->jobsPrefix = this->thingTopic + "/jobs/";
+    this->listPendingJobsRequested = false;
+#endif
+#ifndef AWS_IOT_DISABLE_COMMANDS
+    this->commandPrefix = "$aws/commands/things/" + thingName + "/executions/";
+#endif
+#ifdef AWS_IOT_METRICS
+    this->metricsInterval = 0;
+    this->metricsPublishedAt = 0;
+    this->heapSampledAt = 0;
+    this->metrics.reset();
+#endif
 
 #ifdef LOG_INFO
     Serial.printf("[INFO] ThingClient initialized for thing: %s\n", thingName.c_str());
 #endif
 }
 
+ThingClient::~ThingClient() {
+    if (this->outboundScheduler != nullptr) {
+        this->outboundScheduler->setOutcomeCallback(nullptr);
+    }
+}
+
 void ThingClient::begin() {
     this->isRunning = true;
     this->isClassicReceived = false;
-    this->listPendingJobsRequested = false;
 
-    char commandTopic[1024];
-    snprintf(commandTopic, sizeof(commandTopic), "$aws/commands/things/%s/executions/+/request/json",
-             this->thingName.c_str());
-    this->client->subscribe(commandTopic, 1.0);
+#ifndef AWS_IOT_DISABLE_COMMANDS
+    this->client->subscribe((this->commandPrefix + "+" + COMMAND_REQUEST_SUFFIX).c_str(), 1.0);
+#endif
 
-    auto jobsTopic = StringPrintF("$aws/things/%s", this->thingName.c_str());
+#ifndef AWS_IOT_DISABLE_JOBS
+    this->listPendingJobsRequested = false;
 
-    this->client->subscribe((jobsTopic + "/jobs/notify").c_str(), 1.0);
-    this->client->subscribe((jobsTopic + "/jobs/+/get/accepted").c_str(), 1.0);
+    this->client->subscribe((this->thingTopic + JOBS_NOTIFY_SUFFIX).c_str(), 1.0);
+    this->client->subscribe((this->thingTopic + JOBS_ANY_GET_ACCEPTED_SUFFIX).c_str(), 1.0);
+#endif
 
 #ifdef LOG_INFO
     Serial.println("[INFO] ThingClient started.");
@@ -57,6 +112,15 @@ void ThingClient::setCallback(ThingClientCallback callback) {
 #endif
 }
 
+void ThingClient::setCallback(ThingClientCallbackFunction callback) {
+    this->callback = callback;
+
+#ifdef LOG_DEBUG
+    Serial.println("[DEBUG] Main callback set.");
+#endif
+}
+
+#ifndef AWS_IOT_DISABLE_COMMANDS
 void ThingClient::setCommandCallback(ThingClientCommandCallback callback) {
     this->commandCallback = callback;
 
@@ -65,6 +129,16 @@ void ThingClient::setCommandCallback(ThingClientCommandCallback callback) {
 #endif
 }
 
+void ThingClient::setCommandCallback(ThingClientCommandCallbackFunction callback) {
+    this->commandCallback = callback;
+
+#ifdef LOG_DEBUG
+    Serial.println("[DEBUG] Command callback set.");
+#endif
+}
+#endif
+
+#ifndef AWS_IOT_DISABLE_JOBS
 void ThingClient::setJobsCallback(ThingClientJobsCallback callback) {
     this->jobsCallback = callback;
 
@@ -73,6 +147,15 @@ void ThingClient::setJobsCallback(ThingClientJobsCallback callback) {
 #endif
 }
 
+void ThingClient::setJobsCallback(ThingClientJobsCallbackFunction callback) {
+    this->jobsCallback = callback;
+
+#ifdef LOG_DEBUG
+    Serial.println("[DEBUG] Jobs callback set.");
+#endif
+}
+#endif
+
 void ThingClient::setShadowCallback(ThingClientShadowCallback shadowCallback) {
     this->shadowCallback = shadowCallback;
 
@@ -81,23 +164,106 @@ void ThingClient::setShadowCallback(ThingClientShadowCallback shadowCallback) {
 #endif
 }
 
+void ThingClient::setShadowCallback(ThingClientShadowCallbackFunction shadowCallback) {
+    this->shadowCallback = shadowCallback;
+
+#ifdef LOG_DEBUG
+    Serial.println("[DEBUG] Shadow callback set.");
+#endif
+}
+
 void ThingClient::setMessageCallback(ThingClientMessageCallback messageCallback) {
     this->messageCallback = messageCallback;
 }
 
+void ThingClient::setMessageCallback(ThingClientMessageCallbackFunction messageCallback) {
+    this->messageCallback = messageCallback;
+}
+
+void ThingClient::setTraceRecorder(TraceRecorder *traceRecorder) {
+    this->traceRecorder = traceRecorder;
+}
+
+static AwsPublishLane publishLane(AwsRouteClass route) {
+    switch (route) {
+        case ROUTE_COMMAND:
+            return LANE_COMMAND;
+        case ROUTE_JOB:
+            return LANE_JOB;
+        case ROUTE_SHADOW:
+            return LANE_SHADOW;
+        default:
+            return LANE_TELEMETRY;
+    }
+}
+
+#ifdef AWS_IOT_METRICS
+static AwsRouteClass publishRoute(AwsPublishLane lane) {
+    switch (lane) {
+        case LANE_COMMAND:
+            return ROUTE_COMMAND;
+        case LANE_JOB:
+            return ROUTE_JOB;
+        case LANE_SHADOW:
+            return ROUTE_SHADOW;
+        default:
+            return ROUTE_CUSTOM;
+    }
+}
+#endif
+
+void ThingClient::setOutboundScheduler(OutboundScheduler *outboundScheduler) {
+    if (this->outboundScheduler != nullptr) {
+        this->outboundScheduler->setOutcomeCallback(nullptr);
+    }
+    this->outboundScheduler = outboundScheduler;
+
+#ifdef AWS_IOT_METRICS
+    // Queued messages are only counted once the scheduler knows whether they went out.
+    if (outboundScheduler != nullptr) {
+        outboundScheduler->setOutcomeCallback([this](AwsPublishLane lane, size_t bytes, bool published) {
+            if (published) {
+                this->metrics.routes[publishRoute(lane)].recordOutbound(bytes);
+            } else {
+                this->metrics.publishFailures++;
+            }
+        });
+    }
+#endif
+}
+
+bool ThingClient::publishTelemetry(const String &topic, const String &payload) {
+    return publish(ROUTE_CUSTOM, topic, payload);
+}
+
+bool ThingClient::publish(AwsRouteClass route, const String &topic, const String &payload) {
+    if (this->outboundScheduler != nullptr) {
+        // Metrics are updated from the scheduler's outcome callback.
+        return this->outboundScheduler->publish(publishLane(route), topic, payload);
+    }
+
+    bool published = this->client->publish(topic.c_str(), payload.c_str());
+#ifdef AWS_IOT_METRICS
+    if (published) {
+        this->metrics.routes[route].recordOutbound(topic.length() + payload.length());
+    } else {
+        this->metrics.publishFailures++;
+    }
+#endif
+    return published;
+}
+
 void ThingClient::registerShadow(const String &shadowName) {
-    String shadowTopic = StringPrintF("$aws/things/%s/shadow/name/%s",
-                                      this->thingName.c_str(),
-                                      shadowName.c_str());
+    String shadowTopic = this->shadowPrefix + shadowName;
 
     this->shadows[shadowName]["timestamp"] = 0L;
 
-    this->client->subscribe((shadowTopic + "/get/accepted").c_str(), 1.0);
-    this->client->subscribe((shadowTopic + "/get/rejected").c_str(), 1.0);
-    this->client->subscribe((shadowTopic + "/update/delta").c_str(), 1.0);
-    this->client->subscribe((shadowTopic + "/update/accepted").c_str(), 1.0);
-    this->client->subscribe((shadowTopic + "/update/rejected").c_str(), 1.0);
-    this->client->subscribe((shadowTopic + "/update/documents").c_str(), 1.0);
+    this->client->subscribe((shadowTopic + GET_ACCEPTED_SUFFIX).c_str(), 1.0);
+    this->client->subscribe((shadowTopic + GET_REJECTED_SUFFIX).c_str(), 1.0);
+    this->client->subscribe((shadowTopic + UPDATE_DELTA_SUFFIX).c_str(), 1.0);
+    this->client->subscribe((shadowTopic + UPDATE_ACCEPTED_SUFFIX).c_str(), 1.0);
+    this->client->subscribe((shadowTopic + UPDATE_REJECTED_SUFFIX).c_str(), 1.0);
+    this->client->subscribe((shadowTopic + UPDATE_DOCUMENTS_SUFFIX).c_str(), 1.0);
 
 #ifdef LOG_INFO
     Serial.printf("[INFO] Shadow '%s' registered.\n", shadowName.c_str());
@@ -110,13 +276,15 @@ void ThingClient::preloadShadow(const String &shadowName, JsonObject &payload) {
 
 void ThingClient::requestShadow(const String &shadowName) {
     if (this->client->connected()) {
-        String shadowTopic = StringPrintF("$aws/things/%s/shadow/name/%s/get",
-                                          this->thingName.c_str(),
-                                          shadowName.c_str());
-        this->client->publish(shadowTopic.c_str(), "{}");
+        String shadowTopic = this->shadowPrefix + shadowName + GET_SUFFIX;
+        publish(ROUTE_SHADOW, shadowTopic, "{}");
     }
 }
 
+bool ThingClient::isRegistered(const String &shadowName) {
+    return !this->shadows[shadowName].isNull();
+}
+
 bool ThingClient::isValidated(const String &shadowName) {
     return this->shadows[shadowName]["loaded"].as<bool>();
 }
@@ -126,9 +294,7 @@ void ThingClient::preloadedShadowValidated(const String &shadowName) {
 }
 
 void ThingClient::updateShadow(const String &shadowName, JsonObject &payload) {
-    String updateTopic = StringPrintF("$aws/things/%s/shadow/name/%s/update",
-                                      this->thingName.c_str(),
-                                      shadowName.c_str());
+    String updateTopic = this->shadowPrefix + shadowName + UPDATE_SUFFIX;
 
     JsonDocument reply_payload;
     String jsonString;
@@ -136,35 +302,28 @@ void ThingClient::updateShadow(const String &shadowName, JsonObject &payload) {
     reply_payload["state"]["reported"] = payload;
     serializeJson(reply_payload, jsonString);
 
-    this->client->publish(updateTopic.c_str(), jsonString.c_str());
+    publish(ROUTE_SHADOW, updateTopic, jsonString);
     this->shadows[shadowName]["state"] = payload;
     this->shadows[shadowName]["loaded"] = true;
 
-#ifdef LOG_INFO
-    Serial.printf("[INFO] Shadow '%s' updated with reported state.\n", shadowName.c_str());
-#endif
-#ifdef LOG_DEBUG
-    Serial.printf("[DEBUG] Published payload: %s\n", jsonString.c_str());
-#endif
+    AWS_LOG_INFO("Shadow '%s' updated with reported state.", shadowName.c_str());
+    AWS_LOG_DEBUG("Published payload: %s", jsonString.c_str());
 }
 
 JsonObject ThingClient::getShadow(const String &shadowName) {
     auto state = this->shadows[shadowName]["state"].as<JsonObject>();
-#ifdef LOG_DEBUG
     if (state.isNull()) {
-        Serial.printf("[DEBUG] Shadow '%s' state is null.\n", shadowName.c_str());
+        AWS_LOG_DEBUG("Shadow '%s' state is null.", shadowName.c_str());
     } else {
-        Serial.printf("[DEBUG] Shadow '%s' state retrieved.\n", shadowName.c_str());
+        AWS_LOG_DEBUG("Shadow '%s' state retrieved.", shadowName.c_str());
     }
-#endif
     return state.isNull() ? JsonObject() : state;
 }
 
+#ifndef AWS_IOT_DISABLE_JOBS
 void ThingClient::listPendingJobs() {
     if (!listPendingJobsRequested) {
-        String topic = StringPrintF("$aws/things/%s/jobs/get",
-                                    this->thingName.c_str()
-        );
+        String topic = this->thingTopic + JOBS_GET_SUFFIX;
 
         JsonDocument payload;
         String jsonString;
@@ -173,14 +332,12 @@ void ThingClient::listPendingJobs() {
         serializeJson(payload, jsonString);
 
         listPendingJobsRequested = true;
-        this->client->publish(topic.c_str(), jsonString.c_str());
+        publish(ROUTE_JOB, topic, jsonString);
     }
 }
 
 void ThingClient::startPendingJobs(unsigned int timeout) {
-    String topic = StringPrintF("$aws/things/%s/jobs/start-next",
-                                this->thingName.c_str()
-    );
+    String topic = this->thingTopic + JOBS_START_NEXT_SUFFIX;
 
     JsonDocument doc;
     String jsonString;
@@ -191,14 +348,14 @@ void ThingClient::startPendingJobs(unsigned int timeout) {
     }
     serializeJson(doc, jsonString);
 
-    this->client->publish(topic.c_str(), jsonString.c_str());
+    publish(ROUTE_JOB, topic, jsonString);
 }
 
+#endif
+
+#ifndef AWS_IOT_DISABLE_COMMANDS
 void ThingClient::commandReply(const String &executionId, const CommandReply &payload) {
-    String topic = StringPrintF("$aws/commands/things/%s/executions/%s/response/json",
-                                this->thingName.c_str(),
-                                executionId.c_str()
-    );
+    String topic = this->commandPrefix + executionId + COMMAND_RESPONSE_SUFFIX;
 
     JsonDocument doc;
     String jsonString;
@@ -209,14 +366,13 @@ void ThingClient::commandReply(const String &executionId, const CommandReply &pa
     doc["result"] = payload.result;
     serializeJson(doc, jsonString);
 
-    this->client->publish(topic.c_str(), jsonString.c_str());
+    publish(ROUTE_COMMAND, topic, jsonString);
 }
+#endif
 
+#ifndef AWS_IOT_DISABLE_JOBS
 void ThingClient::jobReply(const String &jobId, const JobReply &payload) {
-    String topic = StringPrintF("$aws/things/%s/jobs/%s/update",
-                                this->thingName.c_str(),
-                                jobId.c_str()
-    );
+    String topic = this->jobsPrefix + jobId + UPDATE_SUFFIX;
 
     JsonDocument doc;
     String jsonString;
@@ -227,14 +383,11 @@ void ThingClient::jobReply(const String &jobId, const JobReply &payload) {
 
     serializeJson(doc, jsonString);
 
-    this->client->publish(topic.c_str(), jsonString.c_str());
+    publish(ROUTE_JOB, topic, jsonString);
 }
 
 void ThingClient::requestJobDetail(const String &jobId) {
-    String topic = StringPrintF("$aws/things/%s/jobs/%s/get",
-                                this->thingName.c_str(),
-                                jobId.c_str()
-    );
+    String topic = this->jobsPrefix + jobId + GET_SUFFIX;
 
     JsonDocument doc;
     String jsonString;
@@ -245,21 +398,20 @@ void ThingClient::requestJobDetail(const String &jobId) {
     doc["jobId"] = jobId;
     serializeJson(doc, jsonString);
 
-    this->client->publish(topic.c_str(), jsonString.c_str());
+    publish(ROUTE_JOB, topic, jsonString);
 }
 
-bool ThingClient::processCommandMessage(const String &topic, JsonDocument &payload) {
-    char commandPrefix[1024];
-    String executionId;
-    JsonDocument reply_payload;
-    String jsonString;
-
-    snprintf(commandPrefix, sizeof(commandPrefix), "$aws/commands/things/%s/executions/", this->thingName.c_str());
-    size_t nameOffset = strlen(commandPrefix);
+#endif
 
-    if (topic.startsWith(commandPrefix)) {
-        if (topic.endsWith("/request/json")) {
-            executionId = topic.substring(nameOffset, topic.length() - 13);
+#ifndef AWS_IOT_DISABLE_COMMANDS
+bool ThingClient::processCommandMessage(const String &topic, JsonDocument &payload) {
+    if (topic.startsWith(this->commandPrefix)) {
+        if (topic.endsWith(COMMAND_REQUEST_SUFFIX)) {
+            String executionId;
+            if (!extractTopicLevel(topic, this->commandPrefix.length(), TOPIC_SUFFIX_LENGTH(COMMAND_REQUEST_SUFFIX),
+                                   executionId)) {
+                return false;
+            }
 
             if (commandCallback != nullptr) {
                 this->commandCallback(executionId, payload);
@@ -270,99 +422,93 @@ bool ThingClient::processCommandMessage(const String &topic, JsonDocument &paylo
 
     return false;
 }
+#endif
 
+#ifndef AWS_IOT_DISABLE_JOBS
 bool ThingClient::processJobMessage(const String &topic, JsonDocument &payload) {
-    char commandPrefix[1024];
-    String shadowTopic;
-    String shadowName;
-    JsonDocument reply_payload;
-    String jsonString;
-    String jobId;
-
-    snprintf(commandPrefix, sizeof(commandPrefix), "$aws/things/%s/jobs/", this->thingName.c_str());
-    size_t nameOffset = strlen(commandPrefix);
-
-    if (topic.startsWith(commandPrefix)) {
-        if (topic.endsWith("/jobs/get/accepted")) {
+    if (topic.startsWith(this->jobsPrefix)) {
+        if (topic.endsWith(JOBS_GET_ACCEPTED_SUFFIX)) {
             // handle /jobs/get/accepted (list all jobs)
             listPendingJobsRequested = false;
             if (jobsCallback != nullptr) {
                 jobsCallback("", payload);
             }
             return true;
-        } else if (topic.endsWith("/jobs/start-next/accepted")) {
+        } else if (topic.endsWith(JOBS_START_NEXT_ACCEPTED_SUFFIX)) {
             // handle /jobs/get/accepted (list all jobs and start them)
             return true;
-        } else if (topic.endsWith("/jobs/notify")) {
+        } else if (topic.endsWith(JOBS_NOTIFY_SUFFIX)) {
             // notification for newly job added
             listPendingJobs();
             return true;
-        } else if (topic.endsWith("/get/accepted")) {
+        } else if (topic.endsWith(GET_ACCEPTED_SUFFIX)) {
             // handle /get/accepted (job detail)
-            jobId = topic.substring(nameOffset, topic.length() - 13);
+            String jobId;
+            if (!extractTopicLevel(topic, this->jobsPrefix.length(), TOPIC_SUFFIX_LENGTH(GET_ACCEPTED_SUFFIX), jobId)) {
+                return false;
+            }
             if (jobsCallback != nullptr) {
                 jobsCallback(jobId, payload);
             }
             return true;
-        } else if (topic.endsWith("/update/accepted")) {
-            // handle /get/accepted (job update)
-            jobId = topic.substring(nameOffset, topic.length() - 13);
-
-            return true;
+        } else if (topic.endsWith(UPDATE_ACCEPTED_SUFFIX)) {
+            // handle /get/accepted (job update), nothing uses the job id so only check the topic shape
+            return hasTopicLevel(topic, this->jobsPrefix.length(), TOPIC_SUFFIX_LENGTH(UPDATE_ACCEPTED_SUFFIX));
         }
     }
 
     return false;
 }
+#endif
 
 bool ThingClient::processShadowMessage(const String &topic, JsonDocument &payload) {
-    char shadowChars[1024];
-    String shadowTopic;
     String shadowName;
-    JsonDocument reply_payload;
-    String jsonString;
+    size_t nameOffset = this->shadowPrefix.length();
 
-    snprintf(shadowChars, sizeof(shadowChars), "$aws/things/%s/shadow/name/", this->thingName.c_str());
-    size_t nameOffset = strlen(shadowChars);
-
-    if (topic.startsWith(shadowChars)) {
-        if (topic.endsWith("/get/accepted")) {
+    if (topic.startsWith(this->shadowPrefix)) {
+        if (topic.endsWith(GET_ACCEPTED_SUFFIX)) {
             JsonObject desired = payload["state"]["desired"];
             if (!desired.isNull()) {
-                shadowName = topic.substring(nameOffset, topic.length() - 13);
+                if (!extractTopicLevel(topic, nameOffset, TOPIC_SUFFIX_LENGTH(GET_ACCEPTED_SUFFIX), shadowName)) {
+                    return false;
+                }
 
-                String publishTopic = topic.substring(0, topic.length() - 13) + "/update";
                 if (this->shadowCallback != nullptr) {
                     this->shadowCallback(shadowName, desired, true);
                 }
-#ifdef LOG_INFO
-                Serial.printf("[INFO] Shadow '%s' GET accepted received.\n", shadowName.c_str());
-#endif
+                AWS_LOG_INFO("Shadow '%s' GET accepted received.", shadowName.c_str());
                 return true;
             }
         }
 
-        if (topic.endsWith("/update/delta")) {
-            shadowName = topic.substring(nameOffset, topic.length() - 13);
+        if (topic.endsWith(UPDATE_DELTA_SUFFIX)) {
+            if (!extractTopicLevel(topic, nameOffset, TOPIC_SUFFIX_LENGTH(UPDATE_DELTA_SUFFIX), shadowName)) {
+                return false;
+            }
 
-            this->shadows[shadowName]["delta"] = 1;
+            // Only track registered shadows, otherwise every unknown name grows the cache and gets polled by loop().
+            if (isRegistered(shadowName)) {
+                this->shadows[shadowName]["delta"] = 1;
+            }
             return true;
         }
 
-        if (topic.endsWith("/update/documents")) {
+        if (topic.endsWith(UPDATE_DOCUMENTS_SUFFIX)) {
             JsonObject desired = payload["current"]["state"]["desired"];
             if (!desired.isNull()) {
-                shadowName = topic.substring(nameOffset, topic.length() - 17);
+                if (!extractTopicLevel(topic, nameOffset, TOPIC_SUFFIX_LENGTH(UPDATE_DOCUMENTS_SUFFIX), shadowName)) {
+                    return false;
+                }
 
                 if (this->shadowCallback != nullptr) {
                     bool shouldMutate = this->shadows[shadowName]["delta"].as<int>() > 0;
 
-                    this->shadows[shadowName]["delta"] = 0;
+                    if (isRegistered(shadowName)) {
+                        this->shadows[shadowName]["delta"] = 0;
+                    }
                     this->shadowCallback(shadowName, desired, shouldMutate);
                 }
-#ifdef LOG_INFO
-                Serial.printf("[INFO] Shadow '%s' UPDATE documents received.\n", shadowName.c_str());
-#endif
+                AWS_LOG_INFO("Shadow '%s' UPDATE documents received.", shadowName.c_str());
                 return true;
             }
 
@@ -381,36 +527,70 @@ bool ThingClient::processMessage(const String &topic, JsonDocument &payload) {
     return false;
 }
 
-bool ThingClient::onMessage(const String &topic, JsonDocument &payload) {
-    if (!this->isRunning) {
-#ifdef LOG_DEBUG
-        Serial.println("[DEBUG] Received message but ThingClient is not running.");
-#endif
-        return false;
-    }
-
+bool ThingClient::dispatchMessage(const String &topic, JsonDocument &payload, AwsRouteClass &route) {
+    route = ROUTE_SHADOW;
     if (processShadowMessage(topic, payload)) {
         return true;
     }
 
+#ifndef AWS_IOT_DISABLE_COMMANDS
+    route = ROUTE_COMMAND;
     if (processCommandMessage(topic, payload)) {
         return true;
     }
+#endif
 
+#ifndef AWS_IOT_DISABLE_JOBS
+    route = ROUTE_JOB;
     if (processJobMessage(topic, payload)) {
         return true;
     }
+#endif
 
+    route = ROUTE_CUSTOM;
     if (processMessage(topic, payload)) {
         return true;
     }
 
-#ifdef LOG_DEBUG
-    Serial.printf("[DEBUG] Received topic: %s but no handler matched.\n", topic.c_str());
-#endif
     return false;
 }
 
+bool ThingClient::onMessage(const String &topic, JsonDocument &payload, unsigned int length) {
+    if (!this->isRunning) {
+        AWS_LOG_DEBUG("Received message but ThingClient is not running.");
+        return false;
+    }
+
+    if (this->traceRecorder != nullptr) {
+        this->traceRecorder->record(topic, payload);
+    }
+
+#ifdef AWS_IOT_METRICS
+    unsigned long startedAt = micros();
+#endif
+    AwsRouteClass route;
+    bool handled = dispatchMessage(topic, payload, route);
+#ifdef AWS_IOT_METRICS
+    // Shadow rejections still go on to the message callback, they are only counted here, and once.
+    bool rejected = topic.startsWith(this->shadowPrefix) && topic.endsWith("/rejected");
+    if (rejected) {
+        this->metrics.rejectedResponses++;
+        AWS_LOG_DEBUG("Shadow request rejected on %s.", topic.c_str());
+    }
+
+    if (handled) {
+        this->metrics.routes[route].recordInbound(topic.length() + length, micros() - startedAt);
+    } else if (!rejected) {
+        this->metrics.unhandledMessages++;
+    }
+#endif
+
+    if (!handled) {
+        AWS_LOG_DEBUG("Received topic: %s but no handler matched.", topic.c_str());
+    }
+    return handled;
+}
+
 void ThingClient::loop() {
     if (this->isRunning) {
         unsigned long now = millis() + 10000L;
@@ -419,27 +599,90 @@ void ThingClient::loop() {
             auto key = kv.key();
             auto shadow = this->shadows[key].as<JsonObject>();
 
-#ifdef LOG_TRACE
-            Serial.printf("[DEBUG] Visiting shadow '%s'.\n", key.c_str());
-#endif
+            AWS_LOG_TRACE("Visiting shadow '%s'.", key.c_str());
             if (shadow["loaded"].isNull()) {
                 auto time = shadow["timestamp"].as<unsigned long>();
 
-#ifdef LOG_TRACE
-                Serial.printf("[DEBUG] Checking if we can start sending out %ul, %ul, %d\n", now, time, (now - time) > 10 * 1000);
-#endif
+                AWS_LOG_TRACE("Checking if we can start sending out %lu, %lu, %d", now, time, (now - time) > 10 * 1000);
                 if (now - time > 10 * 1000L) {
+#ifdef AWS_IOT_METRICS
+                    if (time != 0) {
+                        this->metrics.retries++;
+                    }
+#endif
                     shadow["timestamp"] = millis() + 10000L;
                     requestShadow(key.c_str());
                     // String shadowTopic = StringPrintF("$aws/things/%s/shadow/name/%s/get",
                     //                                   this->thingName.c_str(),
                     //                                   key.c_str());
                     // this->client->publish(shadowTopic.c_str(), "{}");
-#ifdef LOG_DEBUG
-                    Serial.printf("[DEBUG] Requested state for shadow '%s'.\n", key.c_str());
-#endif
+                    AWS_LOG_DEBUG("Requested state for shadow '%s'.", key.c_str());
                 }
             }
         }
+
+        if (this->outboundScheduler != nullptr) {
+            this->outboundScheduler->loop();
+        }
+
+        if (this->traceRecorder != nullptr) {
+            this->traceRecorder->loop();
+        }
+
+#ifdef AWS_IOT_DEFERRED_LOG
+        AwsLog.loop();
+#endif
+
+#ifdef AWS_IOT_METRICS
+        if (millis() - this->heapSampledAt >= AWS_METRICS_HEAP_INTERVAL) {
+            this->heapSampledAt = millis();
+            this->metrics.heap.sample();
+        }
+
+        if (this->metricsInterval > 0 && millis() - this->metricsPublishedAt >= this->metricsInterval) {
+            this->metricsPublishedAt = millis();
+            publishMetrics(this->metricsShadowName);
+        }
+#endif
     }
 }
+
+#ifdef AWS_IOT_METRICS
+const ThingClientMetrics &ThingClient::getMetrics() const {
+    return this->metrics;
+}
+
+void ThingClient::resetMetrics() {
+    this->metrics.reset();
+}
+
+bool ThingClient::publishMetrics(const String &shadowName) {
+    String updateTopic = this->shadowPrefix + shadowName + UPDATE_SUFFIX;
+    // Same limit PubSubClient::publish applies: fixed header, topic length field, topic and payload.
+    size_t room = this->client->getBufferSize() - MQTT_MAX_HEADER_SIZE - 2;
+    room = room > updateTopic.length() ? room - updateTopic.length() : 0;
+
+    JsonDocument doc;
+    String jsonString;
+
+    // Publish straight to the update topic, the diagnostics shadow is not tracked in the local shadow cache.
+    this->metrics.toJson(doc["state"]["reported"].to<JsonObject>());
+    if (measureJson(doc) > room) {
+        this->metrics.toJson(doc["state"]["reported"].to<JsonObject>(), false);
+    }
+    if (measureJson(doc) > room) {
+        this->metrics.publishFailures++;
+        AWS_LOG_INFO("Metrics report does not fit the MQTT buffer, raise it with setBufferSize().");
+        return false;
+    }
+    serializeJson(doc, jsonString);
+
+    return publish(ROUTE_SHADOW, updateTopic, jsonString);
+}
+
+void ThingClient::setMetricsReporting(const String &shadowName, unsigned long interval) {
+    this->metricsShadowName = shadowName;
+    this->metricsInterval = interval;
+    this->metricsPublishedAt = millis();
+}
+#endif
@@ -39,4 +39,18 @@ String thingNameWithMac(const char *name) {
     snprintf(buffer, sizeof(buffer), "%s-%s", name, WiFi.macAddress().c_str());
 
     return {buffer};
-}
\ No newline at end of file
+}
+
+bool hasTopicLevel(const String &topic, size_t prefixLength, size_t suffixLength) {
+    return topic.length() > prefixLength + suffixLength &&
+           topic.indexOf('/', prefixLength) == (int) (topic.length() - suffixLength);
+}
+
+bool extractTopicLevel(const String &topic, size_t prefixLength, size_t suffixLength, String &level) {
+    if (!hasTopicLevel(topic, prefixLength, suffixLength)) {
+        return false;
+    }
+
+    level = topic.substring(prefixLength, topic.length() - suffixLength);
+    return true;
+}
@@ -5,4 +5,12 @@ String StringPrintF(const char *format, ...);
 
 String thingNameWithMac(const char *name);
 
+// Checks that exactly one non-empty topic level sits between prefix and suffix, without copying it out.
+// Every suffix starts with '/', so the first '/' after the prefix has to be where the suffix begins.
+bool hasTopicLevel(const String &topic, size_t prefixLength, size_t suffixLength);
+
+// Extracts the single topic level between prefix and suffix. Rejects topics where the two overlap,
+// the level is empty, or it spans several levels, instead of handing a mis-sliced name to the callbacks.
+bool extractTopicLevel(const String &topic, size_t prefixLength, size_t suffixLength, String &level);
+
 #endif
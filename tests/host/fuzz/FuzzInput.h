@@ -0,0 +1,102 @@
+// Shared helpers for the fuzz targets: a byte reader over the fuzzer input, payload decoding and seed building.
+//
+// Inputs are a sequence of messages, each encoded as
+//   uint8 selector, uint8 level length, level bytes, uint16 payload length (little endian), payload bytes
+// so the fuzzer can reach the topic routing, the topic level extraction and the payload handlers independently.
+
+#ifndef FUZZ_INPUT_H
+#define FUZZ_INPUT_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define FUZZ_CHECK(condition)                                                           \
+    do {                                                                                \
+        if (!(condition)) {                                                             \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            abort();                                                                    \
+        }                                                                               \
+    } while (0)
+
+class FuzzInput {
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+
+public:
+    FuzzInput(const uint8_t *data, size_t size) : data(data), size(size), offset(0) {
+    }
+
+    size_t remaining() const { return this->size - this->offset; }
+
+    uint8_t byte() { return remaining() > 0 ? this->data[this->offset++] : 0; }
+
+    uint16_t uint16() {
+        uint16_t low = byte();
+        return low | (uint16_t) (byte() << 8);
+    }
+
+    // Returns a pointer into the input and advances past at most length bytes.
+    const uint8_t *take(size_t &length) {
+        if (length > remaining()) {
+            length = remaining();
+        }
+        const uint8_t *start = this->data + this->offset;
+        this->offset += length;
+        return start;
+    }
+
+    String string(size_t length) {
+        const uint8_t *start = take(length);
+        String value;
+        value.concat((const char *) start, length);
+        return value;
+    }
+};
+
+struct FuzzMessage {
+    uint8_t selector;
+    String level;
+    const uint8_t *payload;
+    size_t payloadLength;
+};
+
+inline bool nextMessage(FuzzInput &input, FuzzMessage &message) {
+    if (input.remaining() < 2) {
+        return false;
+    }
+
+    message.selector = input.byte();
+    message.level = input.string(input.byte());
+    message.payloadLength = input.uint16();
+    message.payload = input.take(message.payloadLength);
+    return true;
+}
+
+// Payloads arrive as JSON on the wire, MessagePack is tried as well since the trace files store it.
+inline void decodePayload(JsonDocument &payload, const uint8_t *data, size_t length) {
+    if (deserializeJson(payload, (const char *) data, length) && deserializeMsgPack(payload, data, length)) {
+        payload.clear();
+    }
+}
+
+inline std::string fuzzMessage(uint8_t selector, const std::string &level, const std::string &payload) {
+    std::string out;
+    out += (char) selector;
+    out += (char) level.size();
+    out += level;
+    out += (char) (payload.size() & 0xff);
+    out += (char) (payload.size() >> 8);
+    out += payload;
+    return out;
+}
+
+// Each target lists the inputs the standalone driver mutates, and that --write-seeds exports as a corpus.
+const std::vector<std::string> &fuzzSeeds();
+
+#endif //FUZZ_INPUT_H
@@ -0,0 +1,149 @@
+// Feeds arbitrary topics and payloads through ThingClient::onMessage(), covering the shadow, job and command routes.
+
+#include "FuzzInput.h"
+
+#include <AwsIoTCore.h>
+#include <AwsOutbound.h>
+
+static const char THING_NAME[] = "fuzz-thing";
+
+enum FuzzTopic : uint8_t {
+    TOPIC_SHADOW_GET_ACCEPTED = 0,
+    TOPIC_SHADOW_GET_REJECTED,
+    TOPIC_SHADOW_UPDATE_ACCEPTED,
+    TOPIC_SHADOW_UPDATE_REJECTED,
+    TOPIC_SHADOW_UPDATE_DELTA,
+    TOPIC_SHADOW_UPDATE_DOCUMENTS,
+    TOPIC_JOBS_NOTIFY,
+    TOPIC_JOBS_GET_ACCEPTED,
+    TOPIC_JOBS_START_NEXT_ACCEPTED,
+    TOPIC_JOB_GET_ACCEPTED,
+    TOPIC_JOB_UPDATE_ACCEPTED,
+    TOPIC_COMMAND_REQUEST,
+    TOPIC_SHADOW_RAW,
+    TOPIC_RAW,
+    TOPIC_COUNT
+};
+
+// The low bits pick the topic, the top bit runs loop() after the message.
+static String fuzzTopic(uint8_t selector, const String &level) {
+    String thing = String("$aws/things/") + THING_NAME;
+    String shadow = thing + "/shadow/name/";
+
+    switch ((selector & 0x7f) % TOPIC_COUNT) {
+        case TOPIC_SHADOW_GET_ACCEPTED:
+            return shadow + level + "/get/accepted";
+        case TOPIC_SHADOW_GET_REJECTED:
+            return shadow + level + "/get/rejected";
+        case TOPIC_SHADOW_UPDATE_ACCEPTED:
+            return shadow + level + "/update/accepted";
+        case TOPIC_SHADOW_UPDATE_REJECTED:
+            return shadow + level + "/update/rejected";
+        case TOPIC_SHADOW_UPDATE_DELTA:
+            return shadow + level + "/update/delta";
+        case TOPIC_SHADOW_UPDATE_DOCUMENTS:
+            return shadow + level + "/update/documents";
+        case TOPIC_JOBS_NOTIFY:
+            return thing + "/jobs/notify" + level;
+        case TOPIC_JOBS_GET_ACCEPTED:
+            return thing + "/jobs/get/accepted" + level;
+        case TOPIC_JOBS_START_NEXT_ACCEPTED:
+            return thing + "/jobs/start-next/accepted" + level;
+        case TOPIC_JOB_GET_ACCEPTED:
+            return thing + "/jobs/" + level + "/get/accepted";
+        case TOPIC_JOB_UPDATE_ACCEPTED:
+            return thing + "/jobs/" + level + "/update/accepted";
+        case TOPIC_COMMAND_REQUEST:
+            return String("$aws/commands/things/") + THING_NAME + "/executions/" + level + "/request/json";
+        case TOPIC_SHADOW_RAW:
+            return shadow + level;
+        default:
+            return level;
+    }
+}
+
+// Names cut out of a topic must be a single non-empty level.
+static void checkLevel(const String &level) {
+    FUZZ_CHECK(level.length() > 0);
+    FUZZ_CHECK(level.indexOf('/') < 0);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    Serial.setMuted(true);
+    hostUseManualClock(true);
+    hostSetMicros(1000000);
+
+    PubSubClient mqtt;
+    mqtt.setBufferSize(512);
+    ThingClient client(&mqtt, THING_NAME);
+    OutboundScheduler scheduler(&mqtt);
+    scheduler.setRate(LANE_TELEMETRY, 2, 2);
+    client.setOutboundScheduler(&scheduler);
+
+    String reply;
+    client.setShadowCallback([&](const String &shadowName, JsonObject &payload, bool shouldMutate) {
+        checkLevel(shadowName);
+        serializeJson(payload, reply);
+        return shouldMutate;
+    });
+    client.setCommandCallback([&](const String &executionId, JsonDocument &payload) {
+        checkLevel(executionId);
+        serializeJson(payload, reply);
+        return true;
+    });
+    client.setJobsCallback([&](const String &jobId, JsonDocument &payload) {
+        serializeJson(payload, reply);
+        return payload["fail"].isNull();
+    });
+    client.setMessageCallback([&](const String &topic, JsonDocument &payload) {
+        serializeJson(payload, reply);
+        return client.publishTelemetry("fuzz/telemetry", reply);
+    });
+
+    client.begin();
+    client.registerShadow("config");
+    client.registerShadow("state");
+
+    FuzzInput input(data, size);
+    FuzzMessage message;
+    JsonDocument payload;
+    while (nextMessage(input, message)) {
+        decodePayload(payload, message.payload, message.payloadLength);
+        client.onMessage(fuzzTopic(message.selector, message.level), payload, message.payloadLength);
+
+        if (message.selector & 0x80) {
+            hostAdvanceMicros(5000000);
+            client.loop();
+        }
+    }
+
+    client.loop();
+#ifdef AWS_IOT_METRICS
+    client.publishMetrics("diagnostics");
+#endif
+    return 0;
+}
+
+const std::vector<std::string> &fuzzSeeds() {
+    static const std::vector<std::string> seeds = {
+        fuzzMessage(TOPIC_SHADOW_GET_ACCEPTED, "config", R"({"state":{"desired":{"a":1},"reported":{"a":0}}})"),
+        fuzzMessage(TOPIC_SHADOW_GET_REJECTED, "state", R"({"code":404,"message":"No shadow exists"})"),
+        fuzzMessage(TOPIC_SHADOW_UPDATE_DELTA, "config", R"({"state":{"a":2},"version":3})") +
+        fuzzMessage(TOPIC_SHADOW_UPDATE_DOCUMENTS | 0x80, "config",
+                    R"({"current":{"state":{"desired":{"a":2}}},"previous":{}})"),
+        fuzzMessage(TOPIC_SHADOW_UPDATE_ACCEPTED, "config", R"({"state":{"reported":{"a":2}}})") +
+        fuzzMessage(TOPIC_SHADOW_UPDATE_REJECTED, "config", R"({"code":400})"),
+        fuzzMessage(TOPIC_JOBS_NOTIFY, "", R"({"jobs":{"QUEUED":[{"jobId":"job-1"}]}})"),
+        fuzzMessage(TOPIC_JOBS_GET_ACCEPTED, "", R"({"queuedJobs":[{"jobId":"job-1"}],"inProgressJobs":[]})") +
+        fuzzMessage(TOPIC_JOB_GET_ACCEPTED | 0x80, "job-1",
+                    R"({"execution":{"jobId":"job-1","status":"QUEUED","jobDocument":{"op":"reboot"}}})"),
+        fuzzMessage(TOPIC_JOBS_START_NEXT_ACCEPTED, "",
+                    R"({"execution":{"jobId":"job-2","jobDocument":{"op":"update"}}})"),
+        fuzzMessage(TOPIC_JOB_UPDATE_ACCEPTED, "job-1", R"({"timestamp":1})"),
+        fuzzMessage(TOPIC_COMMAND_REQUEST, "exec-1", R"({"command":"blink","times":3})"),
+        fuzzMessage(TOPIC_RAW | 0x80, "devices/fuzz/custom", R"({"value":[1,2,3]})"),
+        fuzzMessage(TOPIC_SHADOW_RAW, "a/b/update/delta", R"({"state":{}})"),
+        fuzzMessage(TOPIC_SHADOW_GET_ACCEPTED, "config", "\x81\xa5" "state\x81\xa7" "desired\x81\xa1" "a\x01"),
+    };
+    return seeds;
+}
@@ -0,0 +1,55 @@
+// Replays arbitrary bytes as a trace file, the reader has to cope with truncated and oversized records.
+
+#include "FuzzInput.h"
+
+#include <AwsIoTCore.h>
+#include <AwsTrace.h>
+#include <LittleFS.h>
+
+static const char TRACE_PATH[] = "/fuzz.trace";
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    Serial.setMuted(true);
+    LittleFS.format();
+    // Records claiming more than this run into the short read path instead of a huge allocation.
+    LittleFS.setCapacity(64 * 1024);
+
+    File file = LittleFS.open(TRACE_PATH, FILE_WRITE, true);
+    file.write(data, size);
+    file.close();
+
+    PubSubClient mqtt;
+    ThingClient client(&mqtt, "fuzz-thing");
+    client.begin();
+    client.registerShadow("config");
+
+    TraceReplayer replayer;
+    TraceReplayStats stats;
+    if (replayer.replay(LittleFS, TRACE_PATH, client, 0, stats)) {
+        FUZZ_CHECK(stats.handled <= stats.messages);
+    }
+    return 0;
+}
+
+static std::string traceRecord(uint32_t offset, const std::string &topic, const std::string &msgpack) {
+    std::string out;
+    for (int i = 0; i < 4; i++) out += (char) (offset >> (8 * i));
+    for (int i = 0; i < 2; i++) out += (char) (topic.size() >> (8 * i));
+    for (int i = 0; i < 4; i++) out += (char) (msgpack.size() >> (8 * i));
+    return out + topic + msgpack;
+}
+
+const std::vector<std::string> &fuzzSeeds() {
+    static const std::string header("AWTR\x01", 5);
+    static const std::vector<std::string> seeds = {
+        header,
+        header + traceRecord(0, "$aws/things/fuzz-thing/shadow/name/config/update/delta",
+                             std::string("\x81\xa5state\x81\xa1" "a\x01", 11)),
+        header + traceRecord(5, "devices/custom", std::string("\x92\x01\xa2hi", 5)) +
+        traceRecord(9, "$aws/things/fuzz-thing/jobs/notify", std::string("\x80", 1)),
+        header + traceRecord(1, "x", std::string("\xdf\xff\xff\xff\xff", 5)),
+        // Lengths whose sum wraps to zero in 32 bits.
+        header + std::string("\x00\x00\x00\x00\x01\x00\xff\xff\xff\xff" "x", 11),
+    };
+    return seeds;
+}
@@ -0,0 +1,142 @@
+// Stand-in for the libFuzzer driver so the targets also build and run with gcc in ctest.
+//
+//   target [--runs N] [--seed S] [--write-seeds DIR] [FILE...]
+//
+// Files are run as given, otherwise the target's seeds are run and then mutated deterministically for N runs.
+// --write-seeds exports the seeds as a starting corpus for a libFuzzer or AFL build.
+
+#include "FuzzInput.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#define FUZZ_MAX_INPUT 4096
+
+class Xorshift {
+    uint64_t state;
+
+public:
+    explicit Xorshift(uint64_t seed) : state(seed ? seed : 0x9e3779b97f4a7c15ULL) {
+    }
+
+    uint64_t next() {
+        this->state ^= this->state << 13;
+        this->state ^= this->state >> 7;
+        this->state ^= this->state << 17;
+        return this->state;
+    }
+
+    size_t below(size_t bound) { return bound > 0 ? next() % bound : 0; }
+};
+
+// Bytes that flip JSON / MessagePack parsers and topic splitting into their interesting branches.
+static const uint8_t INTERESTING[] = {'{', '}', '[', ']', '"', ':', ',', '/', '\\', '+', '#', 0x00, 0x7f, 0x80,
+                                      0xc0, 0xc1, 0xd9, 0xdc, 0xdd, 0xde, 0xdf, 0xff};
+
+static void mutate(std::string &input, const std::vector<std::string> &seeds, Xorshift &random) {
+    size_t count = 1 + random.below(8);
+    for (size_t i = 0; i < count; i++) {
+        size_t position = random.below(input.size() + 1);
+        switch (random.below(7)) {
+            case 0:
+                if (!input.empty()) {
+                    input[position % input.size()] ^= (char) (1 << random.below(8));
+                }
+                break;
+            case 1:
+                if (!input.empty()) {
+                    input[position % input.size()] = (char) random.next();
+                }
+                break;
+            case 2:
+                input.insert(position, 1, (char) INTERESTING[random.below(sizeof(INTERESTING))]);
+                break;
+            case 3:
+                if (!input.empty()) {
+                    input.erase(position % input.size(), 1 + random.below(8));
+                }
+                break;
+            case 4:
+                if (!input.empty()) {
+                    size_t start = random.below(input.size());
+                    input.insert(position, input.substr(start, 1 + random.below(32)));
+                }
+                break;
+            case 5: {
+                const std::string &other = seeds[random.below(seeds.size())];
+                input.insert(position, other.substr(random.below(other.size() + 1)));
+                break;
+            }
+            default:
+                input.resize(position);
+                break;
+        }
+    }
+
+    if (input.size() > FUZZ_MAX_INPUT) {
+        input.resize(FUZZ_MAX_INPUT);
+    }
+}
+
+static int run(const std::string &input) {
+    return LLVMFuzzerTestOneInput((const uint8_t *) input.data(), input.size());
+}
+
+int main(int argc, char **argv) {
+    unsigned long runs = 10000;
+    uint64_t seed = 1;
+    const char *seedDirectory = nullptr;
+    std::vector<const char *> files;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            runs = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--write-seeds") == 0 && i + 1 < argc) {
+            seedDirectory = argv[++i];
+        } else {
+            files.push_back(argv[i]);
+        }
+    }
+
+    const std::vector<std::string> &seeds = fuzzSeeds();
+
+    if (seedDirectory != nullptr) {
+        for (size_t i = 0; i < seeds.size(); i++) {
+            std::ofstream out(std::string(seedDirectory) + "/seed-" + std::to_string(i), std::ios::binary);
+            out << seeds[i];
+        }
+        return 0;
+    }
+
+    if (!files.empty()) {
+        for (const char *path: files) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                fprintf(stderr, "cannot read %s\n", path);
+                return 1;
+            }
+            run(std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()));
+        }
+        printf("ran %zu inputs\n", files.size());
+        return 0;
+    }
+
+    for (const std::string &input: seeds) {
+        run(input);
+    }
+
+    Xorshift random(seed);
+    for (unsigned long i = 0; i < runs; i++) {
+        std::string input = seeds[random.below(seeds.size())];
+        mutate(input, seeds, random);
+        run(input);
+    }
+
+    printf("ran %zu seeds and %lu mutated inputs (seed %llu)\n", seeds.size(), runs, (unsigned long long) seed);
+    return 0;
+}
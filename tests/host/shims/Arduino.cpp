@@ -0,0 +1,352 @@
+#include "Arduino.h"
+#include "HostHeap.h"
+
+#include <chrono>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+void String::init() {
+    this->buffer = nullptr;
+    this->capacity = 0;
+    this->len = 0;
+}
+
+bool String::reserve(unsigned int size) {
+    if (this->buffer != nullptr && this->capacity >= size) {
+        return true;
+    }
+
+    auto *grown = (char *) realloc(this->buffer, size + 1);
+    if (grown == nullptr) {
+        return false;
+    }
+    if (this->buffer == nullptr) {
+        grown[0] = '\0';
+    }
+    this->buffer = grown;
+    this->capacity = size;
+    return true;
+}
+
+bool String::copy(const char *value, unsigned int length) {
+    if (!reserve(length)) {
+        return false;
+    }
+    memmove(this->buffer, value, length);
+    this->buffer[length] = '\0';
+    this->len = length;
+    return true;
+}
+
+String::String(const char *value) {
+    init();
+    if (value != nullptr) {
+        copy(value, strlen(value));
+    }
+}
+
+String::String(const char *value, unsigned int length) {
+    init();
+    copy(value, length);
+}
+
+String::String(const __FlashStringHelper *value) : String(reinterpret_cast<const char *>(value)) {
+}
+
+String::String(const String &value) {
+    init();
+    copy(value.c_str(), value.len);
+}
+
+String::String(String &&value) noexcept {
+    this->buffer = value.buffer;
+    this->capacity = value.capacity;
+    this->len = value.len;
+    value.init();
+}
+
+String::String(char value) {
+    init();
+    copy(&value, 1);
+}
+
+static void formatInto(String &target, const char *format, ...) {
+    char buffer[64];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    target = buffer;
+}
+
+String::String(int value, unsigned char base) {
+    init();
+    formatInto(*this, base == 16 ? "%x" : "%d", value);
+}
+
+String::String(unsigned int value, unsigned char base) {
+    init();
+    formatInto(*this, base == 16 ? "%x" : "%u", value);
+}
+
+String::String(long value, unsigned char base) {
+    init();
+    formatInto(*this, base == 16 ? "%lx" : "%ld", value);
+}
+
+String::String(unsigned long value, unsigned char base) {
+    init();
+    formatInto(*this, base == 16 ? "%lx" : "%lu", value);
+}
+
+String::String(double value, unsigned int decimalPlaces) {
+    init();
+    formatInto(*this, "%.*f", (int) decimalPlaces, value);
+}
+
+String::~String() {
+    free(this->buffer);
+}
+
+String &String::operator=(const String &rhs) {
+    if (this != &rhs) {
+        copy(rhs.c_str(), rhs.len);
+    }
+    return *this;
+}
+
+String &String::operator=(String &&rhs) noexcept {
+    if (this != &rhs) {
+        free(this->buffer);
+        this->buffer = rhs.buffer;
+        this->capacity = rhs.capacity;
+        this->len = rhs.len;
+        rhs.init();
+    }
+    return *this;
+}
+
+String &String::operator=(const char *rhs) {
+    if (rhs == nullptr) {
+        this->len = 0;
+        if (this->buffer != nullptr) {
+            this->buffer[0] = '\0';
+        }
+    } else {
+        copy(rhs, strlen(rhs));
+    }
+    return *this;
+}
+
+bool String::concat(const char *value, unsigned int length) {
+    if (length == 0) {
+        return true;
+    }
+    if (!reserve(this->len + length)) {
+        return false;
+    }
+    memmove(this->buffer + this->len, value, length);
+    this->len += length;
+    this->buffer[this->len] = '\0';
+    return true;
+}
+
+String operator+(const String &lhs, const String &rhs) {
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+String operator+(const String &lhs, const char *rhs) {
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+String operator+(const char *lhs, const String &rhs) {
+    String result(lhs);
+    result.concat(rhs);
+    return result;
+}
+
+bool String::equals(const String &other) const {
+    return this->len == other.len && memcmp(c_str(), other.c_str(), this->len) == 0;
+}
+
+bool String::equals(const char *other) const {
+    return strcmp(c_str(), other != nullptr ? other : "") == 0;
+}
+
+bool String::startsWith(const String &prefix) const {
+    return startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String &prefix, unsigned int offset) const {
+    if (offset + prefix.len > this->len) {
+        return false;
+    }
+    return memcmp(c_str() + offset, prefix.c_str(), prefix.len) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+    if (suffix.len > this->len) {
+        return false;
+    }
+    return memcmp(c_str() + this->len - suffix.len, suffix.c_str(), suffix.len) == 0;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+    if (fromIndex >= this->len) {
+        return -1;
+    }
+    const char *found = (const char *) memchr(c_str() + fromIndex, ch, this->len - fromIndex);
+    return found != nullptr ? (int) (found - c_str()) : -1;
+}
+
+int String::indexOf(const String &value, unsigned int fromIndex) const {
+    if (fromIndex > this->len) {
+        return -1;
+    }
+    const char *found = strstr(c_str() + fromIndex, value.c_str());
+    return found != nullptr ? (int) (found - c_str()) : -1;
+}
+
+int String::lastIndexOf(char ch) const {
+    const char *found = strrchr(c_str(), ch);
+    return found != nullptr ? (int) (found - c_str()) : -1;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+    // Same as the Arduino core: reversed bounds are swapped, out of range bounds are clamped.
+    if (beginIndex > endIndex) {
+        unsigned int swap = beginIndex;
+        beginIndex = endIndex;
+        endIndex = swap;
+    }
+    if (beginIndex >= this->len) {
+        return String();
+    }
+    if (endIndex > this->len) {
+        endIndex = this->len;
+    }
+    return String(c_str() + beginIndex, endIndex - beginIndex);
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (written < size && write(buffer[written]) == 1) {
+        written++;
+    }
+    return written;
+}
+
+size_t Print::printf(const char *format, ...) {
+    char small[256];
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    int size = vsnprintf(small, sizeof(small), format, copy);
+    va_end(copy);
+
+    size_t written = 0;
+    if (size < 0) {
+        written = 0;
+    } else if ((size_t) size < sizeof(small)) {
+        written = write((const uint8_t *) small, size);
+    } else {
+        char *large = (char *) malloc(size + 1);
+        vsnprintf(large, size + 1, format, args);
+        written = write((const uint8_t *) large, size);
+        free(large);
+    }
+    va_end(args);
+    return written;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+    size_t count = 0;
+    while (count < length) {
+        int value = read();
+        if (value < 0) {
+            break;
+        }
+        buffer[count++] = (char) value;
+    }
+    return count;
+}
+
+size_t HardwareSerial::write(uint8_t value) {
+    return write(&value, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+    if (!this->muted) {
+        fwrite(buffer, 1, size, stdout);
+    }
+    return size;
+}
+
+static bool manualClock = false;
+static uint64_t manualMicros = 0;
+
+static uint64_t clockMicros() {
+    if (manualClock) {
+        return manualMicros;
+    }
+
+    static const auto startedAt = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startedAt).count();
+}
+
+unsigned long millis() {
+    return clockMicros() / 1000;
+}
+
+unsigned long micros() {
+    return clockMicros();
+}
+
+void delay(unsigned long ms) {
+    if (manualClock) {
+        manualMicros += (uint64_t) ms * 1000;
+    } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+    }
+}
+
+void yield() {
+    if (manualClock) {
+        manualMicros += 1000;
+    }
+}
+
+void hostUseManualClock(bool manual) {
+    manualClock = manual;
+}
+
+void hostAdvanceMicros(uint64_t micros) {
+    manualMicros += micros;
+}
+
+void hostSetMicros(uint64_t micros) {
+    manualMicros = micros;
+}
+
+uint32_t EspClass::getHeapSize() {
+    return HOST_HEAP_SIZE;
+}
+
+uint32_t EspClass::getFreeHeap() {
+    return hostHeapFree();
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+    return hostHeapMinFree();
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+    return hostHeapLargestFreeBlock();
+}
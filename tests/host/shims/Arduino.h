@@ -0,0 +1,248 @@
+// Host-side stand-in for the Arduino core, just enough of the ESP32 flavour to build and run the library on Linux.
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+class String {
+    char *buffer;
+    unsigned int capacity;
+    unsigned int len;
+
+    void init();
+
+    bool copy(const char *value, unsigned int length);
+
+public:
+    String(const char *value = "");
+
+    String(const char *value, unsigned int length);
+
+    String(const __FlashStringHelper *value);
+
+    String(const String &value);
+
+    String(String &&value) noexcept;
+
+    explicit String(char value);
+
+    explicit String(int value, unsigned char base = 10);
+
+    explicit String(unsigned int value, unsigned char base = 10);
+
+    explicit String(long value, unsigned char base = 10);
+
+    explicit String(unsigned long value, unsigned char base = 10);
+
+    explicit String(double value, unsigned int decimalPlaces = 2);
+
+    ~String();
+
+    String &operator=(const String &rhs);
+
+    String &operator=(String &&rhs) noexcept;
+
+    String &operator=(const char *rhs);
+
+    bool reserve(unsigned int size);
+
+    unsigned int length() const { return this->len; }
+
+    bool isEmpty() const { return this->len == 0; }
+
+    const char *c_str() const { return this->buffer != nullptr ? this->buffer : ""; }
+
+    bool concat(const char *value, unsigned int length);
+
+    bool concat(const String &value) { return concat(value.c_str(), value.len); }
+
+    bool concat(const char *value) { return concat(value, value != nullptr ? strlen(value) : 0); }
+
+    bool concat(char value) { return concat(&value, 1); }
+
+    String &operator+=(const String &rhs) { concat(rhs); return *this; }
+
+    String &operator+=(const char *rhs) { concat(rhs); return *this; }
+
+    String &operator+=(char rhs) { concat(rhs); return *this; }
+
+    friend String operator+(const String &lhs, const String &rhs);
+
+    friend String operator+(const String &lhs, const char *rhs);
+
+    friend String operator+(const char *lhs, const String &rhs);
+
+    bool equals(const String &other) const;
+
+    bool equals(const char *other) const;
+
+    bool operator==(const String &rhs) const { return equals(rhs); }
+
+    bool operator==(const char *rhs) const { return equals(rhs); }
+
+    bool operator!=(const String &rhs) const { return !equals(rhs); }
+
+    bool operator!=(const char *rhs) const { return !equals(rhs); }
+
+    bool operator<(const String &rhs) const { return strcmp(c_str(), rhs.c_str()) < 0; }
+
+    bool startsWith(const String &prefix) const;
+
+    bool startsWith(const String &prefix, unsigned int offset) const;
+
+    bool endsWith(const String &suffix) const;
+
+    char charAt(unsigned int index) const { return index < this->len ? this->buffer[index] : '\0'; }
+
+    char operator[](unsigned int index) const { return charAt(index); }
+
+    int indexOf(char ch, unsigned int fromIndex = 0) const;
+
+    int indexOf(const String &value, unsigned int fromIndex = 0) const;
+
+    int lastIndexOf(char ch) const;
+
+    String substring(unsigned int beginIndex) const { return substring(beginIndex, this->len); }
+
+    String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+    long toInt() const { return atol(c_str()); }
+};
+
+// The Arduino core returns this from operator+, ArduinoJson accepts it wherever it accepts a String.
+class StringSumHelper : public String {
+public:
+    StringSumHelper(const String &value) : String(value) {
+    }
+
+    StringSumHelper(const char *value) : String(value) {
+    }
+};
+
+class Print {
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t value) = 0;
+
+    virtual size_t write(const uint8_t *buffer, size_t size);
+
+    size_t write(const char *value) { return value != nullptr ? write((const uint8_t *) value, strlen(value)) : 0; }
+
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *) buffer, size); }
+
+    virtual void flush() {
+    }
+
+    size_t print(const char *value) { return write(value); }
+
+    size_t print(const String &value) { return write((const uint8_t *) value.c_str(), value.length()); }
+
+    size_t print(const __FlashStringHelper *value) { return print(reinterpret_cast<const char *>(value)); }
+
+    size_t print(char value) { return write((uint8_t) value); }
+
+    size_t print(int value) { return printf("%d", value); }
+
+    size_t print(unsigned int value) { return printf("%u", value); }
+
+    size_t print(long value) { return printf("%ld", value); }
+
+    size_t print(unsigned long value) { return printf("%lu", value); }
+
+    size_t print(double value) { return printf("%.2f", value); }
+
+    size_t println() { return write("\r\n"); }
+
+    template<typename T>
+    size_t println(const T &value) { return print(value) + println(); }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+
+    virtual int read() = 0;
+
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long) {
+    }
+
+    size_t readBytes(char *buffer, size_t length);
+
+    size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *) buffer, length); }
+};
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {
+    }
+
+    size_t write(uint8_t value) override;
+
+    size_t write(const uint8_t *buffer, size_t size) override;
+
+    using Print::write;
+
+    int available() override { return 0; }
+
+    int read() override { return -1; }
+
+    int peek() override { return -1; }
+
+    // Host only: silence library output, e.g. in fuzzing and soak runs.
+    void setMuted(bool muted) { this->muted = muted; }
+
+private:
+    bool muted = false;
+};
+
+extern HardwareSerial Serial;
+
+unsigned long millis();
+
+unsigned long micros();
+
+void delay(unsigned long ms);
+
+void yield();
+
+// Host only: switch millis()/micros() to a manually advanced clock for deterministic simulations. delay() and
+// yield() then advance it, yield() by a millisecond, so code waiting on the clock still gets there.
+void hostUseManualClock(bool manual);
+
+void hostAdvanceMicros(uint64_t micros);
+
+void hostSetMicros(uint64_t micros);
+
+class EspClass {
+public:
+    uint32_t getHeapSize();
+
+    uint32_t getFreeHeap();
+
+    uint32_t getMinFreeHeap();
+
+    uint32_t getMaxAllocHeap();
+};
+
+extern EspClass ESP;
+
+#endif //HOST_ARDUINO_H
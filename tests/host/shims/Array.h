@@ -0,0 +1,4 @@
+#ifndef HOST_ARRAY_H
+#define HOST_ARRAY_H
+
+#endif //HOST_ARRAY_H
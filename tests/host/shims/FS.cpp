@@ -0,0 +1,255 @@
+#include "FS.h"
+#include "LittleFS.h"
+
+#include <cerrno>
+#include <sys/stat.h>
+
+fs::MemoryFS LittleFS;
+
+namespace fs {
+class MemoryFileImpl : public FileImpl {
+    MemoryFS *owner;
+    std::shared_ptr<std::vector<uint8_t>> data;
+    size_t offset;
+    bool writable;
+
+public:
+    MemoryFileImpl(MemoryFS *owner, std::shared_ptr<std::vector<uint8_t>> data, size_t offset, bool writable)
+        : owner(owner), data(std::move(data)), offset(offset), writable(writable) {
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+        if (!this->writable) {
+            return 0;
+        }
+
+        size_t end = this->offset + size;
+        size_t growth = end > this->data->size() ? end - this->data->size() : 0;
+        if (this->owner->used + growth > this->owner->capacity) {
+            size_t room = this->owner->capacity - this->owner->used;
+            size = size > room ? room : size;
+            end = this->offset + size;
+            growth = end > this->data->size() ? end - this->data->size() : 0;
+        }
+
+        if (end > this->data->size()) {
+            this->data->resize(end);
+        }
+        if (size > 0) {
+            memcpy(this->data->data() + this->offset, buffer, size);
+        }
+        this->offset = end;
+        this->owner->used += growth;
+        return size;
+    }
+
+    size_t read(uint8_t *buffer, size_t size) override {
+        size_t count = available();
+        count = count < size ? count : size;
+        if (count > 0) {
+            memcpy(buffer, this->data->data() + this->offset, count);
+        }
+        this->offset += count;
+        return count;
+    }
+
+    int peek() override {
+        return available() > 0 ? (*this->data)[this->offset] : -1;
+    }
+
+    size_t available() override {
+        return this->data->size() - this->offset;
+    }
+
+    size_t position() override {
+        return this->offset;
+    }
+
+    size_t size() override {
+        return this->data->size();
+    }
+
+    bool seek(size_t position) override {
+        if (position > this->data->size()) {
+            return false;
+        }
+        this->offset = position;
+        return true;
+    }
+
+    void flush() override {
+    }
+
+    void close() override {
+    }
+};
+
+static std::string parentOf(const std::string &path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos || slash == 0 ? "/" : path.substr(0, slash);
+}
+
+MemoryFS::MemoryFS() {
+    this->capacity = SIZE_MAX;
+    this->used = 0;
+    this->directories.insert("/");
+}
+
+void MemoryFS::format() {
+    this->files.clear();
+    this->directories.clear();
+    this->directories.insert("/");
+    this->used = 0;
+}
+
+File MemoryFS::open(const char *path, const char *mode, bool create) {
+    std::string name(path);
+    auto existing = this->files.find(name);
+
+    if (mode[0] == 'r') {
+        if (existing == this->files.end()) {
+            return File();
+        }
+        return File(std::make_shared<MemoryFileImpl>(this, existing->second, 0, mode[1] == '+'));
+    }
+
+    std::string parent = parentOf(name);
+    if (this->directories.count(parent) == 0) {
+        if (!create) {
+            return File();
+        }
+        for (std::string directory = parent; directory != "/"; directory = parentOf(directory)) {
+            this->directories.insert(directory);
+        }
+    }
+
+    if (existing == this->files.end()) {
+        existing = this->files.emplace(name, std::make_shared<std::vector<uint8_t>>()).first;
+    }
+
+    auto data = existing->second;
+    if (mode[0] == 'w') {
+        this->used -= data->size();
+        data->clear();
+    }
+    return File(std::make_shared<MemoryFileImpl>(this, data, data->size(), true));
+}
+
+bool MemoryFS::exists(const char *path) {
+    return this->files.count(path) > 0 || this->directories.count(path) > 0;
+}
+
+bool MemoryFS::mkdir(const char *path) {
+    if (exists(path) || this->directories.count(parentOf(path)) == 0) {
+        return false;
+    }
+    this->directories.insert(path);
+    return true;
+}
+
+bool MemoryFS::remove(const char *path) {
+    auto existing = this->files.find(path);
+    if (existing == this->files.end()) {
+        return false;
+    }
+    this->used -= existing->second->size();
+    this->files.erase(existing);
+    return true;
+}
+
+class HostFileImpl : public FileImpl {
+    FILE *file;
+
+public:
+    explicit HostFileImpl(FILE *file) : file(file) {
+    }
+
+    ~HostFileImpl() override {
+        close();
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+        return this->file != nullptr ? fwrite(buffer, 1, size, this->file) : 0;
+    }
+
+    size_t read(uint8_t *buffer, size_t size) override {
+        return this->file != nullptr ? fread(buffer, 1, size, this->file) : 0;
+    }
+
+    int peek() override {
+        if (this->file == nullptr) {
+            return -1;
+        }
+        int value = fgetc(this->file);
+        if (value != EOF) {
+            ungetc(value, this->file);
+        }
+        return value == EOF ? -1 : value;
+    }
+
+    size_t available() override {
+        return size() - position();
+    }
+
+    size_t position() override {
+        return this->file != nullptr ? ftell(this->file) : 0;
+    }
+
+    size_t size() override {
+        if (this->file == nullptr) {
+            return 0;
+        }
+        long current = ftell(this->file);
+        fseek(this->file, 0, SEEK_END);
+        long end = ftell(this->file);
+        fseek(this->file, current, SEEK_SET);
+        return end;
+    }
+
+    bool seek(size_t position) override {
+        return this->file != nullptr && fseek(this->file, (long) position, SEEK_SET) == 0;
+    }
+
+    void flush() override {
+        if (this->file != nullptr) {
+            fflush(this->file);
+        }
+    }
+
+    void close() override {
+        if (this->file != nullptr) {
+            fclose(this->file);
+            this->file = nullptr;
+        }
+    }
+};
+
+HostFS::HostFS(const std::string &root) : root(root) {
+}
+
+std::string HostFS::resolve(const char *path) const {
+    return this->root + (path[0] == '/' ? "" : "/") + path;
+}
+
+File HostFS::open(const char *path, const char *mode, bool create) {
+    std::string hostMode = mode[0] == 'r' ? "rb" : mode[0] == 'a' ? "ab" : "wb";
+    FILE *file = fopen(resolve(path).c_str(), hostMode.c_str());
+    if (file == nullptr) {
+        return File();
+    }
+    return File(std::make_shared<HostFileImpl>(file));
+}
+
+bool HostFS::exists(const char *path) {
+    struct stat info{};
+    return stat(resolve(path).c_str(), &info) == 0;
+}
+
+bool HostFS::mkdir(const char *path) {
+    return ::mkdir(resolve(path).c_str(), 0755) == 0;
+}
+
+bool HostFS::remove(const char *path) {
+    return ::remove(resolve(path).c_str()) == 0;
+}
+}
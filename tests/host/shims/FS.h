@@ -0,0 +1,181 @@
+// Host-side stand-in for the ESP32 fs::FS / fs::File API, with an in-memory and a host directory backed implementation.
+
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include "Arduino.h"
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+class FileImpl {
+public:
+    virtual ~FileImpl() = default;
+
+    virtual size_t write(const uint8_t *buffer, size_t size) = 0;
+
+    virtual size_t read(uint8_t *buffer, size_t size) = 0;
+
+    virtual int peek() = 0;
+
+    virtual size_t available() = 0;
+
+    virtual size_t position() = 0;
+
+    virtual size_t size() = 0;
+
+    virtual bool seek(size_t position) = 0;
+
+    virtual void flush() = 0;
+
+    virtual void close() = 0;
+};
+
+class File : public Stream {
+    std::shared_ptr<FileImpl> impl;
+
+public:
+    File() = default;
+
+    explicit File(std::shared_ptr<FileImpl> impl) : impl(std::move(impl)) {
+    }
+
+    size_t write(uint8_t value) override { return write(&value, 1); }
+
+    size_t write(const uint8_t *buffer, size_t size) override { return impl ? impl->write(buffer, size) : 0; }
+
+    using Print::write;
+
+    int available() override { return impl ? (int) impl->available() : 0; }
+
+    int read() override {
+        uint8_t value;
+        return read(&value, 1) == 1 ? value : -1;
+    }
+
+    size_t read(uint8_t *buffer, size_t size) { return impl ? impl->read(buffer, size) : 0; }
+
+    int peek() override { return impl ? impl->peek() : -1; }
+
+    void flush() override {
+        if (impl) {
+            impl->flush();
+        }
+    }
+
+    bool seek(uint32_t position) { return impl && impl->seek(position); }
+
+    size_t position() const { return impl ? impl->position() : 0; }
+
+    size_t size() const { return impl ? impl->size() : 0; }
+
+    void close() {
+        if (impl) {
+            impl->close();
+            impl.reset();
+        }
+    }
+
+    operator bool() const { return impl != nullptr; }
+};
+
+class FS {
+public:
+    virtual ~FS() = default;
+
+    virtual File open(const char *path, const char *mode = FILE_READ, bool create = false) = 0;
+
+    File open(const String &path, const char *mode = FILE_READ, bool create = false) {
+        return open(path.c_str(), mode, create);
+    }
+
+    virtual bool exists(const char *path) = 0;
+
+    bool exists(const String &path) { return exists(path.c_str()); }
+
+    virtual bool mkdir(const char *path) = 0;
+
+    bool mkdir(const String &path) { return mkdir(path.c_str()); }
+
+    virtual bool remove(const char *path) = 0;
+
+    bool remove(const String &path) { return remove(path.c_str()); }
+};
+
+// Keeps everything in RAM. A capacity can be set to make writes fail once the "flash" is full.
+class MemoryFS : public FS {
+    std::map<std::string, std::shared_ptr<std::vector<uint8_t>>> files;
+    std::set<std::string> directories;
+    size_t capacity;
+    size_t used;
+
+    friend class MemoryFileImpl;
+
+public:
+    MemoryFS();
+
+    bool begin(bool formatOnFail = false) { return true; }
+
+    void end() {
+    }
+
+    File open(const char *path, const char *mode = FILE_READ, bool create = false) override;
+
+    using FS::open;
+
+    bool exists(const char *path) override;
+
+    using FS::exists;
+
+    bool mkdir(const char *path) override;
+
+    using FS::mkdir;
+
+    bool remove(const char *path) override;
+
+    using FS::remove;
+
+    // Host only.
+    void setCapacity(size_t capacity) { this->capacity = capacity; }
+
+    void format();
+};
+
+// Maps paths onto a directory of the host filesystem, used by the host tools to read and write real files.
+class HostFS : public FS {
+    std::string root;
+
+    std::string resolve(const char *path) const;
+
+public:
+    explicit HostFS(const std::string &root);
+
+    File open(const char *path, const char *mode = FILE_READ, bool create = false) override;
+
+    using FS::open;
+
+    bool exists(const char *path) override;
+
+    using FS::exists;
+
+    bool mkdir(const char *path) override;
+
+    using FS::mkdir;
+
+    bool remove(const char *path) override;
+
+    using FS::remove;
+};
+}
+
+using fs::File;
+
+#endif //HOST_FS_H
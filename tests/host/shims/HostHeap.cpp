@@ -0,0 +1,133 @@
+#include "HostHeap.h"
+
+#include <atomic>
+#include <malloc.h>
+
+static std::atomic<uint64_t> allocations(0);
+static std::atomic<uint64_t> frees(0);
+static std::atomic<int64_t> bytesInUse(0);
+static std::atomic<int64_t> peakBytesInUse(0);
+static std::atomic<int64_t> baselineBytes(0);
+
+#ifdef HOST_HEAP_TRACKING
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+void *__libc_memalign(size_t alignment, size_t size);
+}
+
+static void track(void *ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    allocations++;
+    int64_t inUse = bytesInUse += malloc_usable_size(ptr);
+    int64_t peak = peakBytesInUse.load();
+    while (inUse > peak && !peakBytesInUse.compare_exchange_weak(peak, inUse)) {
+    }
+}
+
+static void untrack(void *ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    frees++;
+    bytesInUse -= malloc_usable_size(ptr);
+}
+
+extern "C" void *malloc(size_t size) {
+    void *ptr = __libc_malloc(size);
+    track(ptr);
+    return ptr;
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+    void *ptr = __libc_calloc(count, size);
+    track(ptr);
+    return ptr;
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+    if (ptr == nullptr) {
+        return malloc(size);
+    }
+
+    // Count a moving realloc as a free plus an allocation, like a heap_caps realloc does on the device.
+    size_t previous = malloc_usable_size(ptr);
+    void *grown = __libc_realloc(ptr, size);
+    if (grown != nullptr || size == 0) {
+        frees++;
+        bytesInUse -= previous;
+        track(grown);
+    }
+    return grown;
+}
+
+extern "C" void free(void *ptr) {
+    untrack(ptr);
+    __libc_free(ptr);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size) {
+    void *ptr = __libc_memalign(alignment, size);
+    track(ptr);
+    return ptr;
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **result, size_t alignment, size_t size) {
+    *result = memalign(alignment, size);
+    return *result != nullptr ? 0 : 12;
+}
+
+bool hostHeapTracking() {
+    return true;
+}
+#else
+bool hostHeapTracking() {
+    return false;
+}
+#endif
+
+HostHeapCounters hostHeapCounters() {
+    HostHeapCounters counters{};
+    counters.allocations = allocations.load();
+    counters.frees = frees.load();
+    int64_t inUse = bytesInUse.load() - baselineBytes.load();
+    int64_t peak = peakBytesInUse.load() - baselineBytes.load();
+    counters.bytesInUse = inUse > 0 ? inUse : 0;
+    counters.peakBytesInUse = peak > 0 ? peak : 0;
+    return counters;
+}
+
+void hostHeapResetBaseline() {
+    baselineBytes = bytesInUse.load();
+    peakBytesInUse = bytesInUse.load();
+}
+
+static uint32_t freeFrom(uint64_t used) {
+    return used >= HOST_HEAP_SIZE ? 0 : (uint32_t) (HOST_HEAP_SIZE - used);
+}
+
+uint32_t hostHeapFree() {
+    return freeFrom(hostHeapCounters().bytesInUse);
+}
+
+uint32_t hostHeapMinFree() {
+    return freeFrom(hostHeapCounters().peakBytesInUse);
+}
+
+uint32_t hostHeapLargestFreeBlock() {
+    // glibc does not expose its largest free chunk. Free memory below the top chunk (fordblks - keepcost) sits in
+    // holes between live blocks, so treat it as unusable for one large allocation, which is what fragmentation means
+    // for the device allocator as well.
+    struct mallinfo2 info = mallinfo2();
+    uint64_t holes = info.fordblks > info.keepcost ? info.fordblks - info.keepcost : 0;
+    uint32_t free = hostHeapFree();
+    return holes >= free ? 0 : (uint32_t) (free - holes);
+}
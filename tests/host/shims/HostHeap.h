@@ -0,0 +1,34 @@
+// Heap accounting for host builds. malloc/free are interposed so the counters see every allocation,
+// including the ones made by String, ArduinoJson and the C++ runtime, and report them through the ESP API.
+
+#ifndef HOST_HEAP_H
+#define HOST_HEAP_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Notional heap size reported as ESP.getHeapSize(), close to the free heap of an ESP32 after WiFi and TLS.
+#define HOST_HEAP_SIZE (256u * 1024u)
+
+struct HostHeapCounters {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytesInUse;
+    uint64_t peakBytesInUse;
+};
+
+// Returns false when interposition is compiled out (sanitizer builds), the counters then stay at zero.
+bool hostHeapTracking();
+
+HostHeapCounters hostHeapCounters();
+
+// Starts a new measurement window: the current usage becomes the baseline and the peak is reset.
+void hostHeapResetBaseline();
+
+uint32_t hostHeapFree();
+
+uint32_t hostHeapMinFree();
+
+uint32_t hostHeapLargestFreeBlock();
+
+#endif //HOST_HEAP_H
@@ -0,0 +1,57 @@
+#include "PubSubClient.h"
+#include "WiFi.h"
+
+WiFiClass WiFi;
+
+PubSubClient::PubSubClient() {
+    this->bufferSize = MQTT_MAX_PACKET_SIZE;
+    this->isConnected = true;
+}
+
+bool PubSubClient::subscribe(const char *topic, uint8_t) {
+    if (!this->isConnected) {
+        return false;
+    }
+    this->subscriptions.emplace_back(topic);
+    return true;
+}
+
+bool PubSubClient::unsubscribe(const char *topic) {
+    for (auto it = this->subscriptions.begin(); it != this->subscriptions.end(); ++it) {
+        if (*it == topic) {
+            this->subscriptions.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload) {
+    return publish(topic, (const uint8_t *) payload, payload != nullptr ? strlen(payload) : 0, false);
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload, bool retained) {
+    return publish(topic, (const uint8_t *) payload, payload != nullptr ? strlen(payload) : 0, retained);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length, bool) {
+    if (!this->isConnected) {
+        return false;
+    }
+
+    // Same check as PubSubClient 2.8: the whole packet has to fit the buffer.
+    if (this->bufferSize < MQTT_MAX_HEADER_SIZE + 2 + strnlen(topic, this->bufferSize) + length) {
+        return false;
+    }
+
+    this->publishCount++;
+    return !this->sink || this->sink(topic, payload, length);
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+    if (size == 0) {
+        return false;
+    }
+    this->bufferSize = size;
+    return true;
+}
@@ -0,0 +1,52 @@
+// Host-side stand-in for PubSubClient 2.8: no network, publishes are handed to a sink so tests can inspect them.
+
+#ifndef HOST_PUBSUBCLIENT_H
+#define HOST_PUBSUBCLIENT_H
+
+#include "Arduino.h"
+
+#include <string>
+#include <vector>
+
+#define MQTT_MAX_PACKET_SIZE 256
+#define MQTT_MAX_HEADER_SIZE 5
+
+#define HostPublishSink std::function<bool(const char *topic, const uint8_t *payload, unsigned int length)>
+
+class PubSubClient {
+    uint16_t bufferSize;
+    bool isConnected;
+    HostPublishSink sink;
+
+public:
+    PubSubClient();
+
+    bool connected() { return this->isConnected; }
+
+    bool loop() { return this->isConnected; }
+
+    bool subscribe(const char *topic, uint8_t qos = 0);
+
+    bool unsubscribe(const char *topic);
+
+    bool publish(const char *topic, const char *payload);
+
+    bool publish(const char *topic, const char *payload, bool retained);
+
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained = false);
+
+    bool setBufferSize(uint16_t size);
+
+    uint16_t getBufferSize() { return this->bufferSize; }
+
+    // Host only.
+    std::vector<std::string> subscriptions;
+    uint32_t publishCount = 0;
+
+    void hostSetConnected(bool connected) { this->isConnected = connected; }
+
+    // The sink sees every publish that fits the packet buffer; returning false makes publish() fail.
+    void hostSetSink(HostPublishSink sink) { this->sink = std::move(sink); }
+};
+
+#endif //HOST_PUBSUBCLIENT_H
@@ -0,0 +1,13 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include "Arduino.h"
+
+class WiFiClass {
+public:
+    String macAddress() { return "24:0A:C4:00:00:01"; }
+};
+
+extern WiFiClass WiFi;
+
+#endif //HOST_WIFI_H
@@ -0,0 +1,139 @@
+// Deferred log records: argument encoding, formatting on the drain side and the ring running full.
+
+#include <gtest/gtest.h>
+
+#include <AwsLog.h>
+
+#include <memory>
+#include <string>
+
+class CapturePrint : public Print {
+public:
+    std::string text;
+
+    using Print::write;
+
+    size_t write(uint8_t value) override {
+        this->text += (char) value;
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+        this->text.append((const char *) buffer, size);
+        return size;
+    }
+};
+
+class LogTest : public ::testing::Test {
+protected:
+    std::unique_ptr<AwsLogRing> ring;
+
+    void SetUp() override {
+        this->ring.reset(new AwsLogRing());
+        this->ring->setLevel(AWS_LOG_LEVEL_TRACE);
+        this->ring->setOutput(nullptr);
+    }
+
+    std::string next() {
+        AwsLogRecord record;
+        if (!this->ring->read(record)) {
+            return "<empty>";
+        }
+
+        char line[192];
+        this->ring->format(record, line, sizeof(line));
+        return line;
+    }
+};
+
+TEST_F(LogTest, FormatsIntegersAndStrings) {
+    ring->log(AWS_LOG_LEVEL_INFO, "shadow %s v%u (%x) %d%%", "config", 7u, 255, -2);
+    ring->log(AWS_LOG_LEVEL_INFO, "[%5s|%-4d|%04u|%c]", String("ab"), 3, 42u, 'A');
+    ring->log(AWS_LOG_LEVEL_INFO, "%ld %lu %hd", -5L, 4000000000UL, 7);
+
+    EXPECT_EQ("shadow config v7 (ff) -2%", next());
+    EXPECT_EQ("[   ab|3   |0042|A]", next());
+    EXPECT_EQ("-5 4000000000 7", next());
+    EXPECT_EQ("<empty>", next());
+}
+
+TEST_F(LogTest, MissingArgumentsPrintQuestionMarks) {
+    ring->log(AWS_LOG_LEVEL_INFO, "%u and %u, %s", 1u);
+    ring->log(AWS_LOG_LEVEL_INFO, "%s", (const char *) nullptr);
+
+    EXPECT_EQ("1 and ?, ", next());
+    EXPECT_EQ("(null)", next());
+}
+
+// Conversions whose argument the record does not store are refused, the arguments after them still line up.
+TEST_F(LogTest, RefusesUnsupportedConversions) {
+    ring->log(AWS_LOG_LEVEL_INFO, "%lld|%zu|%u", 1UL, 2UL, 3u);
+    ring->log(AWS_LOG_LEVEL_INFO, "%jd|%td|%u", 1UL, 2UL, 3u);
+    ring->log(AWS_LOG_LEVEL_INFO, "%*d|%.*s|%u", 4, 5, 6, "text", 7u);
+    ring->log(AWS_LOG_LEVEL_INFO, "%Lf|%n|%p|%f|%ls|%q|%lc|%u", "wide", 'x', 8u);
+
+    EXPECT_EQ("?|?|3", next());
+    EXPECT_EQ("?|?|3", next());
+    EXPECT_EQ("?|?|7", next());
+    EXPECT_EQ("?|?|?|?|?|?|?|8", next());
+}
+
+TEST_F(LogTest, TruncatesStringsToTheTextBudget) {
+    std::string first(30, 'a');
+    std::string second(30, 'b');
+    ring->log(AWS_LOG_LEVEL_INFO, "%s|%s|%s|%u", first.c_str(), second.c_str(), "dropped", 9u);
+
+    // The first string takes 31 of the 48 bytes, the second gets the 16 characters that still fit with a NUL.
+    EXPECT_EQ(first + "|" + std::string(AWS_LOG_TEXT_SIZE - 31 - 1, 'b') + "||9", next());
+
+    std::string longText(100, 'c');
+    ring->log(AWS_LOG_LEVEL_INFO, "<%s>", longText.c_str());
+    EXPECT_EQ("<" + std::string(AWS_LOG_TEXT_SIZE - 1, 'c') + ">", next());
+}
+
+TEST_F(LogTest, FormatStopsAtTheBufferSize) {
+    ring->log(AWS_LOG_LEVEL_INFO, "abcdef %u", 123456u);
+
+    AwsLogRecord record;
+    ASSERT_TRUE(ring->read(record));
+    char line[10];
+    EXPECT_EQ(9u, ring->format(record, line, sizeof(line)));
+    EXPECT_STREQ("abcdef 12", line);
+    EXPECT_EQ(0u, ring->format(record, line, 0));
+}
+
+TEST_F(LogTest, SkipsRecordsAboveTheLevel) {
+    ring->setLevel(AWS_LOG_LEVEL_INFO);
+    ring->log(AWS_LOG_LEVEL_DEBUG, "hidden");
+    ring->log(AWS_LOG_LEVEL_INFO, "shown");
+
+    EXPECT_EQ("shown", next());
+    EXPECT_EQ("<empty>", next());
+}
+
+TEST_F(LogTest, DropsRecordsWhenFullAndWarnsOnce) {
+    for (unsigned int i = 0; i < AWS_LOG_RING_SIZE + 5; i++) {
+        ring->log(AWS_LOG_LEVEL_INFO, "record %u", i);
+    }
+    EXPECT_EQ(5u, ring->getDropped());
+
+    CapturePrint out;
+    EXPECT_EQ(2u, ring->drain(out, 2));
+    EXPECT_EQ(0u, out.text.find("[WARN] 5 log records dropped\n[INFO] "));
+    EXPECT_NE(std::string::npos, out.text.find(": record 0\n"));
+    EXPECT_NE(std::string::npos, out.text.find(": record 1\n"));
+
+    // The oldest records are kept, the dropped ones are the newest.
+    out.text.clear();
+    EXPECT_EQ(AWS_LOG_RING_SIZE - 2u, ring->drain(out, AWS_LOG_RING_SIZE));
+    EXPECT_EQ(std::string::npos, out.text.find("[WARN]"));
+    EXPECT_NE(std::string::npos, out.text.find(": record 31\n"));
+    EXPECT_EQ(std::string::npos, out.text.find(": record 32\n"));
+
+    // Space is free again, and only new drops are reported.
+    out.text.clear();
+    ring->log(AWS_LOG_LEVEL_INFO, "after");
+    EXPECT_EQ(1u, ring->drain(out, 4));
+    EXPECT_EQ(std::string::npos, out.text.find("[WARN]"));
+    EXPECT_EQ(5u, ring->getDropped());
+}
@@ -0,0 +1,112 @@
+// Metrics report sizing against the MQTT packet buffer and the byte counters fed from onMessage().
+
+#include <gtest/gtest.h>
+
+#include <AwsIoTCore.h>
+
+#include <string>
+
+class MetricsTest : public ::testing::Test {
+protected:
+    PubSubClient mqtt;
+    std::string topic;
+    std::string report;
+    unsigned reports = 0;
+
+    void SetUp() override {
+        mqtt.hostSetSink([this](const char *t, const uint8_t *payload, unsigned int length) {
+            this->topic = t;
+            this->report.assign((const char *) payload, length);
+            this->reports++;
+            return true;
+        });
+    }
+
+    static void shadowTraffic(ThingClient &client, int count) {
+        JsonDocument payload;
+        payload["state"]["a"] = 1;
+        for (int i = 0; i < count; i++) {
+            client.onMessage("$aws/things/device-01/shadow/name/config/update/delta", payload, 40);
+        }
+    }
+};
+
+TEST_F(MetricsTest, ReportFitsThePacketBuffer) {
+    ThingClient client(&mqtt, "device-01");
+    client.begin();
+    client.registerShadow("config");
+    shadowTraffic(client, 50);
+    mqtt.setBufferSize(512);
+
+    ASSERT_TRUE(client.publishMetrics("diagnostics"));
+    EXPECT_EQ("$aws/things/device-01/shadow/name/diagnostics/update", topic);
+    EXPECT_LE(MQTT_MAX_HEADER_SIZE + 2 + topic.size() + report.size(), 512u);
+
+    JsonDocument doc;
+    ASSERT_FALSE(deserializeJson(doc, report.c_str()));
+    JsonObject reported = doc["state"]["reported"];
+    EXPECT_FALSE(reported["shadow"]["handler"]["buckets"].isNull());
+    // Routes without traffic are left out.
+    EXPECT_TRUE(reported["job"].isNull());
+    EXPECT_TRUE(reported["command"].isNull());
+    EXPECT_TRUE(reported["custom"].isNull());
+}
+
+TEST_F(MetricsTest, DropsBucketsBeforeGivingUp) {
+    ThingClient client(&mqtt, "device-01");
+    client.begin();
+    client.registerShadow("config");
+    shadowTraffic(client, 50);
+
+    bool sawSummary = false;
+    bool sawFailure = false;
+    for (uint16_t size = 512; size >= 64 && !sawFailure; size -= 4) {
+        mqtt.setBufferSize(size);
+        unsigned before = reports;
+        uint32_t failures = client.getMetrics().publishFailures;
+
+        if (client.publishMetrics("diagnostics")) {
+            ASSERT_EQ(before + 1, reports);
+            EXPECT_LE(MQTT_MAX_HEADER_SIZE + 2 + topic.size() + report.size(), size);
+            sawSummary |= report.find("buckets") == std::string::npos;
+        } else {
+            // Too small even for the summary: nothing is sent and the failure is counted.
+            EXPECT_EQ(before, reports);
+            EXPECT_EQ(failures + 1, client.getMetrics().publishFailures);
+            sawFailure = true;
+        }
+    }
+
+    EXPECT_TRUE(sawSummary);
+    EXPECT_TRUE(sawFailure);
+}
+
+TEST_F(MetricsTest, CountsBytesFromTheGivenLength) {
+    ThingClient client(&mqtt, "device-01");
+    client.begin();
+    client.registerShadow("config");
+    shadowTraffic(client, 3);
+
+    const AwsRouteMetrics &shadow = client.getMetrics().routes[ROUTE_SHADOW];
+    size_t topicLength = strlen("$aws/things/device-01/shadow/name/config/update/delta");
+    EXPECT_EQ(3u, shadow.messagesIn);
+    EXPECT_EQ(3 * (topicLength + 40), shadow.bytesIn);
+}
+
+TEST_F(MetricsTest, CountsShadowRejectionsOnce) {
+    ThingClient client(&mqtt, "device-01");
+    client.begin();
+    client.registerShadow("config");
+
+    JsonDocument payload;
+    payload["code"] = 404;
+    EXPECT_FALSE(client.onMessage("$aws/things/device-01/shadow/name/config/get/rejected", payload));
+    EXPECT_EQ(1u, client.getMetrics().rejectedResponses);
+    EXPECT_EQ(0u, client.getMetrics().unhandledMessages);
+
+    // With a message callback the rejection is handled there, and still counted as rejected.
+    client.setMessageCallback([](const String &, JsonDocument &) { return true; });
+    EXPECT_TRUE(client.onMessage("$aws/things/device-01/shadow/name/config/update/rejected", payload));
+    EXPECT_EQ(2u, client.getMetrics().rejectedResponses);
+    EXPECT_EQ(0u, client.getMetrics().unhandledMessages);
+}
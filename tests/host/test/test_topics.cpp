@@ -0,0 +1,125 @@
+// Topic level extraction used to pull shadow names, job ids and command execution ids out of inbound topics.
+
+#include <gtest/gtest.h>
+
+#include <AwsIoTCore.h>
+#include "aws_utils.h"
+
+static const String SHADOW_PREFIX = "$aws/things/device-01/shadow/name/";
+static constexpr size_t DELTA_SUFFIX = sizeof("/update/delta") - 1;
+
+TEST(ExtractTopicLevel, ExtractsSingleLevel) {
+    String level;
+    ASSERT_TRUE(extractTopicLevel(SHADOW_PREFIX + "config/update/delta", SHADOW_PREFIX.length(), DELTA_SUFFIX, level));
+    EXPECT_STREQ("config", level.c_str());
+}
+
+TEST(ExtractTopicLevel, RejectsEmptyLevel) {
+    String level = "untouched";
+    EXPECT_FALSE(extractTopicLevel(SHADOW_PREFIX + "/update/delta", SHADOW_PREFIX.length(), DELTA_SUFFIX, level));
+    EXPECT_STREQ("untouched", level.c_str());
+}
+
+TEST(ExtractTopicLevel, RejectsEmptyTopic) {
+    String level;
+    EXPECT_FALSE(extractTopicLevel("", 0, 0, level));
+    EXPECT_FALSE(extractTopicLevel("", SHADOW_PREFIX.length(), DELTA_SUFFIX, level));
+}
+
+TEST(ExtractTopicLevel, RejectsMultipleLevels) {
+    String level;
+    EXPECT_FALSE(extractTopicLevel(SHADOW_PREFIX + "a/b/update/delta", SHADOW_PREFIX.length(), DELTA_SUFFIX, level));
+    EXPECT_FALSE(extractTopicLevel(SHADOW_PREFIX + "config/x/update/delta", SHADOW_PREFIX.length(), DELTA_SUFFIX, level));
+}
+
+TEST(ExtractTopicLevel, RejectsOverlappingPrefixAndSuffix) {
+    String level;
+    // The topic is shorter than prefix and suffix together, so the two would share characters.
+    String topic = "$aws/things/x/update/delta";
+    EXPECT_FALSE(extractTopicLevel(topic, 14, DELTA_SUFFIX, level));
+    EXPECT_FALSE(extractTopicLevel(topic, topic.length(), DELTA_SUFFIX, level));
+    EXPECT_FALSE(extractTopicLevel(topic, topic.length() - DELTA_SUFFIX, DELTA_SUFFIX, level));
+}
+
+TEST(ExtractTopicLevel, RejectsTopicWithoutSuffixSeparator) {
+    String level;
+    // Same length as a valid topic, but the level does not end where the suffix starts.
+    String topic = SHADOW_PREFIX + "configXupdate/delta";
+    EXPECT_FALSE(extractTopicLevel(topic, SHADOW_PREFIX.length(), DELTA_SUFFIX, level));
+}
+
+TEST(ExtractTopicLevel, HandlesLongThingNames) {
+    // AWS IoT allows thing names up to 128 characters.
+    String thingName;
+    for (int i = 0; i < 128; i++) {
+        thingName += (char) ('a' + i % 26);
+    }
+
+    String prefix = "$aws/things/" + thingName + "/shadow/name/";
+    String level;
+    ASSERT_TRUE(extractTopicLevel(prefix + "config/update/delta", prefix.length(), DELTA_SUFFIX, level));
+    EXPECT_STREQ("config", level.c_str());
+
+    String longShadow = thingName + thingName;
+    ASSERT_TRUE(extractTopicLevel(prefix + longShadow + "/update/delta", prefix.length(), DELTA_SUFFIX, level));
+    EXPECT_STREQ(longShadow.c_str(), level.c_str());
+}
+
+TEST(HasTopicLevel, MatchesExtractTopicLevel) {
+    const char *topics[] = {"", "/", "//", "a/b", "$aws/things/t/jobs/1/update/accepted",
+                            "$aws/things/t/jobs//update/accepted", "$aws/things/t/jobs/a/b/update/accepted"};
+    size_t prefix = sizeof("$aws/things/t/jobs/") - 1;
+    size_t suffix = sizeof("/update/accepted") - 1;
+
+    for (const char *topic: topics) {
+        String level;
+        EXPECT_EQ(extractTopicLevel(topic, prefix, suffix, level), hasTopicLevel(topic, prefix, suffix)) << topic;
+    }
+    EXPECT_TRUE(hasTopicLevel("$aws/things/t/jobs/1/update/accepted", prefix, suffix));
+}
+
+// The same rules seen through ThingClient: malformed shadow topics are not dispatched to the shadow callback.
+TEST(ThingClientTopics, DispatchesOnlyWellFormedShadowNames) {
+    PubSubClient mqtt;
+    ThingClient client(&mqtt, "device-01");
+    client.begin();
+    client.registerShadow("config");
+
+    std::vector<std::string> names;
+    client.setShadowCallback([&](const String &name, JsonObject &, bool) {
+        names.emplace_back(name.c_str());
+        return true;
+    });
+
+    JsonDocument payload;
+    payload["current"]["state"]["desired"]["a"] = 1;
+    client.onMessage(SHADOW_PREFIX + "config/update/documents", payload);
+    client.onMessage(SHADOW_PREFIX + "/update/documents", payload);
+    client.onMessage(SHADOW_PREFIX + "a/b/update/documents", payload);
+    client.onMessage("$aws/things/device-01/shadow/name/update/documents", payload);
+
+    ASSERT_EQ(1u, names.size());
+    EXPECT_EQ("config", names[0]);
+}
+
+// Shadow rejections are not consumed by ThingClient, they reach the message callback as they always did.
+TEST(ThingClientTopics, ShadowRejectionsReachMessageCallback) {
+    PubSubClient mqtt;
+    ThingClient client(&mqtt, "device-01");
+    client.begin();
+    client.registerShadow("config");
+
+    std::vector<std::string> topics;
+    client.setMessageCallback([&](const String &topic, JsonDocument &) {
+        topics.emplace_back(topic.c_str());
+        return true;
+    });
+
+    JsonDocument payload;
+    payload["code"] = 404;
+    EXPECT_TRUE(client.onMessage(SHADOW_PREFIX + "config/get/rejected", payload));
+    EXPECT_TRUE(client.onMessage(SHADOW_PREFIX + "config/update/rejected", payload));
+
+    ASSERT_EQ(2u, topics.size());
+    EXPECT_EQ(std::string((SHADOW_PREFIX + "config/get/rejected").c_str()), topics[0]);
+}
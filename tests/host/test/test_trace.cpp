@@ -0,0 +1,167 @@
+// TraceRecorder buffering and failure accounting, and a record / replay round trip.
+
+#include <gtest/gtest.h>
+
+#include <AwsIoTCore.h>
+#include <AwsTrace.h>
+#include <HostHeap.h>
+#include <LittleFS.h>
+
+#include <utility>
+
+static const char TRACE_PATH[] = "/test.trace";
+static const char DELTA_TOPIC[] = "$aws/things/device-01/shadow/name/config/update/delta";
+
+class TraceTest : public ::testing::Test {
+protected:
+    PubSubClient mqtt;
+    JsonDocument payload;
+
+    void SetUp() override {
+        hostUseManualClock(true);
+        hostSetMicros(1000000);
+        LittleFS.format();
+        LittleFS.setCapacity(SIZE_MAX);
+        payload["state"]["interval"] = 30;
+    }
+
+    void TearDown() override {
+        hostUseManualClock(false);
+    }
+
+    static size_t fileSize() {
+        File file = LittleFS.open(TRACE_PATH, FILE_READ);
+        return file ? file.size() : 0;
+    }
+};
+
+TEST_F(TraceTest, BuffersUntilLoopFlushes) {
+    TraceRecorder recorder;
+    ASSERT_TRUE(recorder.begin(LittleFS, TRACE_PATH));
+    size_t headerSize = fileSize();
+
+    for (int i = 0; i < 3; i++) {
+        EXPECT_TRUE(recorder.record(DELTA_TOPIC, payload));
+    }
+    recorder.loop();
+    EXPECT_EQ(headerSize, fileSize());
+    EXPECT_EQ(0u, recorder.getRecordCount());
+
+    hostAdvanceMicros(AWS_TRACE_FLUSH_INTERVAL * 1000UL);
+    recorder.loop();
+    EXPECT_GT(fileSize(), headerSize);
+    EXPECT_EQ(3u, recorder.getRecordCount());
+    recorder.end();
+}
+
+TEST_F(TraceTest, CountsRecordsThatDoNotFit) {
+    TraceRecorder recorder;
+    ASSERT_TRUE(recorder.begin(LittleFS, TRACE_PATH));
+
+    JsonDocument large;
+    for (int i = 0; i < AWS_TRACE_BUFFER_SIZE / 8; i++) {
+        large["values"].add("xxxxxxxx");
+    }
+    EXPECT_FALSE(recorder.record(DELTA_TOPIC, large));
+    EXPECT_TRUE(recorder.record(DELTA_TOPIC, payload));
+    recorder.end();
+
+    EXPECT_EQ(1u, recorder.getRecordCount());
+    EXPECT_EQ(1u, recorder.getFailedCount());
+}
+
+TEST_F(TraceTest, StopsOnFailedWrite) {
+    TraceRecorder recorder;
+    ASSERT_TRUE(recorder.begin(LittleFS, TRACE_PATH));
+    LittleFS.setCapacity(fileSize() + 16);
+
+    for (int i = 0; i < 4; i++) {
+        recorder.record(DELTA_TOPIC, payload);
+    }
+    EXPECT_FALSE(recorder.flush());
+    EXPECT_EQ(0u, recorder.getRecordCount());
+    EXPECT_EQ(4u, recorder.getFailedCount());
+
+    // The recording is over, later messages are not staged.
+    EXPECT_FALSE(recorder.record(DELTA_TOPIC, payload));
+}
+
+TEST_F(TraceTest, ReplaysWhatWasRecorded) {
+    ThingClient client(&mqtt, "device-01");
+    client.begin();
+    client.registerShadow("config");
+
+    TraceRecorder recorder;
+    ASSERT_TRUE(recorder.begin(LittleFS, TRACE_PATH));
+    client.setTraceRecorder(&recorder);
+    for (int i = 0; i < 50; i++) {
+        client.onMessage(DELTA_TOPIC, payload);
+        hostAdvanceMicros(10000);
+        client.loop();
+    }
+    recorder.end();
+    client.setTraceRecorder(nullptr);
+    ASSERT_EQ(50u, recorder.getRecordCount());
+
+    TraceReplayer replayer;
+    TraceReplayStats stats;
+    ASSERT_TRUE(replayer.replay(LittleFS, TRACE_PATH, client, 0, stats));
+    EXPECT_EQ(50u, stats.messages);
+    EXPECT_EQ(50u, stats.handled);
+    EXPECT_EQ(0u, stats.errors);
+}
+
+TEST_F(TraceTest, RejectsTruncatedRecords) {
+    const uint8_t truncated[] = {'A', 'W', 'T', 'R', AWS_TRACE_VERSION,
+                                 0, 0, 0, 0, 4, 0, 0xff, 0xff, 0xff, 0x7f, 't', 'o', 'p', 'i'};
+    // Topic length 1 and payload length 0xffffffff add up to 0 in 32 bits.
+    const uint8_t wrapping[] = {'A', 'W', 'T', 'R', AWS_TRACE_VERSION,
+                                0, 0, 0, 0, 1, 0, 0xff, 0xff, 0xff, 0xff, 'x'};
+    const std::pair<const uint8_t *, size_t> traces[] = {{truncated, sizeof(truncated)}, {wrapping, sizeof(wrapping)}};
+
+    ThingClient client(&mqtt, "device-01");
+    client.begin();
+    TraceReplayer replayer;
+
+    for (const auto &trace: traces) {
+        File file = LittleFS.open(TRACE_PATH, FILE_WRITE, true);
+        file.write(trace.first, trace.second);
+        file.close();
+
+        uint64_t peakBefore = hostHeapCounters().peakBytesInUse;
+        TraceReplayStats stats;
+        ASSERT_TRUE(replayer.replay(LittleFS, TRACE_PATH, client, 0, stats));
+        EXPECT_EQ(0u, stats.messages);
+        EXPECT_EQ(1u, stats.errors);
+        // Nothing close to the claimed lengths may have been allocated.
+        EXPECT_LT(hostHeapCounters().peakBytesInUse, peakBefore + 64 * 1024);
+    }
+}
+
+// A recording longer than the 32-bit micros() range (about 71 minutes) still replays at the recorded pace.
+TEST_F(TraceTest, PacesRecordingsLongerThanTheMicrosRange) {
+    ThingClient client(&mqtt, "device-01");
+    client.begin();
+    client.registerShadow("config");
+
+    const uint64_t span = 160ULL * 60 * 1000000;
+    TraceRecorder recorder;
+    ASSERT_TRUE(recorder.begin(LittleFS, TRACE_PATH));
+    client.setTraceRecorder(&recorder);
+    client.onMessage(DELTA_TOPIC, payload);
+    hostAdvanceMicros(span / 2);
+    client.onMessage(DELTA_TOPIC, payload);
+    hostAdvanceMicros(span / 2);
+    client.onMessage(DELTA_TOPIC, payload);
+    recorder.end();
+    client.setTraceRecorder(nullptr);
+    ASSERT_EQ(3u, recorder.getRecordCount());
+
+    // The manual clock moves a millisecond per yield(), the replayer's wait loop.
+    TraceReplayer replayer;
+    TraceReplayStats stats;
+    ASSERT_TRUE(replayer.replay(LittleFS, TRACE_PATH, client, 2, stats));
+    EXPECT_EQ(3u, stats.handled);
+    EXPECT_GE(stats.elapsedMicros, span / 2);
+    EXPECT_LT(stats.elapsedMicros, span / 2 + 10000);
+}
@@ -0,0 +1,109 @@
+// ThingClient built with -DAWS_IOT_DISABLE_JOBS and -DAWS_IOT_DISABLE_COMMANDS, and the callback holder it uses.
+
+#include <gtest/gtest.h>
+
+#include <AwsIoTCore.h>
+
+#include <string>
+#include <vector>
+
+typedef AwsCallback<bool(const String &, JsonDocument &)> DocumentCallback;
+
+static_assert(sizeof(DocumentCallback) <= 2 * sizeof(void *), "AwsCallback holds a pointer and a flag");
+
+static bool acceptAll(const String &, JsonDocument &) {
+    return true;
+}
+
+// Without the subsystems their topics are ordinary messages, left to the message callback.
+TEST(TrimmedClient, JobsAndCommandTopicsReachMessageCallback) {
+    PubSubClient mqtt;
+    ThingClient client(&mqtt, "device-01");
+    client.begin();
+
+    std::vector<std::string> topics;
+    client.setMessageCallback([&](const String &topic, JsonDocument &) {
+        topics.emplace_back(topic.c_str());
+        return true;
+    });
+
+    JsonDocument payload;
+    payload["jobs"]["QUEUED"][0]["jobId"] = "job-1";
+    EXPECT_TRUE(client.onMessage("$aws/things/device-01/jobs/notify", payload));
+    EXPECT_TRUE(client.onMessage("$aws/commands/things/device-01/executions/e-1/request/json", payload));
+
+    ASSERT_EQ(2u, topics.size());
+    EXPECT_EQ("$aws/things/device-01/jobs/notify", topics[0]);
+    EXPECT_EQ(2u, client.getMetrics().routes[ROUTE_CUSTOM].messagesIn);
+    EXPECT_EQ(0u, client.getMetrics().routes[ROUTE_JOB].messagesIn);
+    EXPECT_EQ(0u, client.getMetrics().routes[ROUTE_COMMAND].messagesIn);
+}
+
+TEST(TrimmedClient, DispatchesShadows) {
+    PubSubClient mqtt;
+    ThingClient client(&mqtt, "device-01");
+    client.begin();
+    client.registerShadow("config");
+
+    int calls = 0;
+    client.setShadowCallback([&](const String &name, JsonObject &, bool) {
+        calls++;
+        return true;
+    });
+
+    JsonDocument payload;
+    payload["current"]["state"]["desired"]["a"] = 1;
+    EXPECT_TRUE(client.onMessage("$aws/things/device-01/shadow/name/config/update/documents", payload));
+    EXPECT_EQ(1, calls);
+    EXPECT_EQ(1u, client.getMetrics().routes[ROUTE_SHADOW].messagesIn);
+}
+
+TEST(AwsCallbackTest, HoldsEitherKind) {
+    DocumentCallback callback;
+    JsonDocument payload;
+    EXPECT_TRUE(callback == nullptr);
+
+    callback = acceptAll;
+    EXPECT_TRUE(callback != nullptr);
+    EXPECT_TRUE(callback("a", payload));
+
+    int calls = 0;
+    callback = ThingClientCallback([&calls](const String &, JsonDocument &) {
+        calls++;
+        return false;
+    });
+    EXPECT_FALSE(callback("a", payload));
+    EXPECT_EQ(1, calls);
+
+    callback = nullptr;
+    EXPECT_TRUE(callback == nullptr);
+
+    callback = ThingClientCallback();
+    EXPECT_TRUE(callback == nullptr);
+}
+
+TEST(AwsCallbackTest, CopiesOwnTheirCallable) {
+    int calls = 0;
+    DocumentCallback copy;
+    {
+        DocumentCallback original;
+        original = ThingClientCallback([&calls](const String &, JsonDocument &) {
+            calls++;
+            return true;
+        });
+        copy = original;
+        DocumentCallback constructed(original);
+        original = acceptAll;
+
+        JsonDocument payload;
+        EXPECT_TRUE(constructed("a", payload));
+    }
+
+    JsonDocument payload;
+    EXPECT_TRUE(copy("a", payload));
+    EXPECT_EQ(2, calls);
+
+    copy = copy;
+    EXPECT_TRUE(copy("a", payload));
+    EXPECT_EQ(3, calls);
+}
@@ -0,0 +1,79 @@
+// Small helpers shared by the host tools: wall clock timing, percentiles, a seeded PRNG and argument parsing.
+
+#ifndef HOST_STATS_H
+#define HOST_STATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// The library's micros() may run on the manual clock, latency is measured against the real one.
+inline uint64_t wallMicros() {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint64_t wallNanos() {
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Nearest rank percentile, sorts the samples in place.
+template<typename T>
+T percentile(std::vector<T> &samples, double percent) {
+    if (samples.empty()) {
+        return T();
+    }
+
+    std::sort(samples.begin(), samples.end());
+    size_t rank = (size_t) (percent / 100.0 * (double) samples.size() + 0.5);
+    rank = rank == 0 ? 0 : rank - 1;
+    return samples[std::min(rank, samples.size() - 1)];
+}
+
+// xorshift64, enough for reproducible simulated traffic.
+class Xorshift {
+    uint64_t state;
+
+public:
+    explicit Xorshift(uint64_t seed) : state(seed ? seed : 0x9e3779b97f4a7c15ULL) {
+    }
+
+    uint64_t next() {
+        this->state ^= this->state << 13;
+        this->state ^= this->state >> 7;
+        this->state ^= this->state << 17;
+        return this->state;
+    }
+
+    // Uniform in [0, 1).
+    double unit() { return (double) (next() >> 11) / (double) (1ULL << 53); }
+
+    // Uniform in [0, bound), bound has to be above 0.
+    uint32_t below(uint32_t bound) { return (uint32_t) (next() % bound); }
+};
+
+// Looks up "--name value" and returns the value, or fallback when the option is absent.
+inline const char *option(int argc, char **argv, const char *name, const char *fallback) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], name) == 0) {
+            return argv[i + 1];
+        }
+    }
+    return fallback;
+}
+
+inline unsigned long optionNumber(int argc, char **argv, const char *name, unsigned long fallback) {
+    const char *value = option(argc, argv, name, nullptr);
+    return value != nullptr ? strtoul(value, nullptr, 10) : fallback;
+}
+
+inline double optionDouble(int argc, char **argv, const char *name, double fallback) {
+    const char *value = option(argc, argv, name, nullptr);
+    return value != nullptr ? strtod(value, nullptr) : fallback;
+}
+
+#endif //HOST_STATS_H
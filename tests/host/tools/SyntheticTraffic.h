@@ -0,0 +1,195 @@
+// Device traffic shared by the soak run and the trace tools: shadow deltas and documents, job notifications and
+// executions, command requests and custom topics.
+//
+// The default generator repeats a fixed eight message cycle, which is what the checked-in trace holds. A seeded
+// one draws the topic kind, the shadow, job and execution names and the payload size from a PRNG, and half of its
+// shadow traffic names shadows that were never registered, so state kept per unknown name shows up as heap growth.
+
+#ifndef SYNTHETIC_TRAFFIC_H
+#define SYNTHETIC_TRAFFIC_H
+
+#include "HostStats.h"
+
+#include <AwsIoTCore.h>
+
+static const char SYNTHETIC_THING_NAME[] = "soak-device-0001";
+
+#define SYNTHETIC_UNREGISTERED_SHADOWS 100000
+#define SYNTHETIC_MAX_VALUES 48
+
+class SyntheticTraffic {
+    String thing;
+    String shadow;
+    String commands;
+    JsonDocument payload;
+    uint32_t sequence;
+    bool isRandom;
+    Xorshift random;
+
+    void cycle(String &topic, uint32_t n) {
+        switch (n % 8) {
+            case 0:
+                topic = this->shadow + "config/update/delta";
+                this->payload["state"]["interval"] = n % 60;
+                this->payload["version"] = n;
+                break;
+            case 1:
+                topic = this->shadow + "config/update/documents";
+                this->payload["current"]["state"]["desired"]["interval"] = n % 60;
+                this->payload["current"]["state"]["desired"]["label"] = "soak";
+                break;
+            case 2:
+                topic = this->shadow + "state/get/accepted";
+                this->payload["state"]["reported"]["uptime"] = n;
+                break;
+            case 3:
+                topic = this->thing + "/jobs/notify";
+                this->payload["jobs"]["QUEUED"][0]["jobId"] = String("job-") + String(n % 16);
+                break;
+            case 4:
+                topic = this->thing + "/jobs/job-" + String(n % 16) + "/get/accepted";
+                this->payload["execution"]["jobId"] = String("job-") + String(n % 16);
+                this->payload["execution"]["jobDocument"]["op"] = "noop";
+                break;
+            case 5:
+                topic = this->commands + "exec-" + String(n) + "/request/json";
+                this->payload["command"] = "blink";
+                this->payload["times"] = n % 5;
+                break;
+            case 6:
+                topic = "devices/soak/settings";
+                for (int i = 0; i < 8; i++) {
+                    this->payload["values"].add(n + i);
+                }
+                break;
+            default:
+                topic = this->shadow + "config/update/accepted";
+                this->payload["state"]["reported"]["interval"] = n % 60;
+                break;
+        }
+    }
+
+    String shadowName() {
+        switch (this->random.below(4)) {
+            case 0:
+                return "config";
+            case 1:
+                return "state";
+            default:
+                return String("unregistered-") + String(this->random.below(SYNTHETIC_UNREGISTERED_SHADOWS));
+        }
+    }
+
+    // Fills object with up to SYNTHETIC_MAX_VALUES numbers and a label of up to 64 characters.
+    void fill(JsonObject object, uint32_t n) {
+        uint32_t values = this->random.below(SYNTHETIC_MAX_VALUES + 1);
+        for (uint32_t i = 0; i < values; i++) {
+            object["values"].add(n + i);
+        }
+        object["label"] = String(std::string(this->random.below(65), 'x').c_str());
+        object["interval"] = n % 60;
+    }
+
+    void draw(String &topic, uint32_t n) {
+        switch (this->random.below(10)) {
+            case 0:
+                topic = this->shadow + shadowName() + "/update/delta";
+                fill(this->payload["state"].to<JsonObject>(), n);
+                this->payload["version"] = n;
+                break;
+            case 1:
+                topic = this->shadow + shadowName() + "/update/documents";
+                fill(this->payload["current"]["state"]["desired"].to<JsonObject>(), n);
+                break;
+            case 2:
+                topic = this->shadow + shadowName() + "/get/accepted";
+                fill(this->payload["state"]["desired"].to<JsonObject>(), n);
+                fill(this->payload["state"]["reported"].to<JsonObject>(), n);
+                break;
+            case 3:
+                topic = this->shadow + shadowName() + (this->random.below(2) ? "/get/rejected" : "/update/rejected");
+                this->payload["code"] = 404;
+                this->payload["message"] = "No shadow exists with name";
+                break;
+            case 4:
+                topic = this->shadow + shadowName() + "/update/accepted";
+                fill(this->payload["state"]["reported"].to<JsonObject>(), n);
+                break;
+            case 5:
+                topic = this->thing + "/jobs/notify";
+                for (uint32_t i = this->random.below(4); i > 0; i--) {
+                    this->payload["jobs"]["QUEUED"].add<JsonObject>()["jobId"] =
+                        String("job-") + String(this->random.below(1000000));
+                }
+                break;
+            case 6: {
+                String jobId = String("job-") + String(this->random.below(1000000));
+                topic = this->thing + "/jobs/" + jobId + "/get/accepted";
+                this->payload["execution"]["jobId"] = jobId;
+                fill(this->payload["execution"]["jobDocument"].to<JsonObject>(), n);
+                break;
+            }
+            case 7:
+                topic = this->commands + "exec-" + String(this->random.below(1000000)) + "/request/json";
+                fill(this->payload.to<JsonObject>(), n);
+                this->payload["command"] = "blink";
+                break;
+            case 8:
+                topic = "devices/soak/settings";
+                fill(this->payload.to<JsonObject>(), n);
+                break;
+            default:
+                topic = String("devices/soak/unknown-") + String(this->random.below(1000000));
+                fill(this->payload.to<JsonObject>(), n);
+                break;
+        }
+    }
+
+public:
+    explicit SyntheticTraffic(uint64_t seed = 0)
+        : thing(String("$aws/things/") + SYNTHETIC_THING_NAME), sequence(0), isRandom(seed != 0), random(seed) {
+        this->shadow = this->thing + "/shadow/name/";
+        this->commands = String("$aws/commands/things/") + SYNTHETIC_THING_NAME + "/executions/";
+    }
+
+    // Builds the next message into topic and the returned document.
+    JsonDocument &next(String &topic) {
+        uint32_t n = this->sequence++;
+        this->payload.clear();
+        if (this->isRandom) {
+            draw(topic, n);
+        } else {
+            cycle(topic, n);
+        }
+        return this->payload;
+    }
+
+    // Frees the last payload, so heap figures taken between messages do not depend on its random size.
+    void release() {
+        this->payload = JsonDocument();
+    }
+};
+
+// The handlers a device built for this traffic would have: shadow values are read back, jobs and commands succeed
+// and the custom topic is answered with telemetry, serialized into reply.
+inline void attachSyntheticHandlers(ThingClient &client, String &reply) {
+    client.setShadowCallback([&reply](const String &, JsonObject &desired, bool shouldMutate) {
+        reply = "";
+        serializeJson(desired, reply);
+        return shouldMutate;
+    });
+    client.setJobsCallback([](const String &, JsonDocument &) { return true; });
+    client.setCommandCallback([](const String &, JsonDocument &) { return true; });
+    client.setMessageCallback([&client, &reply](const String &, JsonDocument &settings) {
+        reply = "";
+        serializeJson(settings, reply);
+        return client.publishTelemetry("devices/soak/telemetry", reply);
+    });
+}
+
+inline void registerSyntheticShadows(ThingClient &client) {
+    client.registerShadow("config");
+    client.registerShadow("state");
+}
+
+#endif //SYNTHETIC_TRAFFIC_H
@@ -0,0 +1,139 @@
+// Soak run for ThingClient: pushes randomized shadow, job, command and custom traffic through onMessage() and
+// loop() in windows, and reports per window heap in use, low watermark, fragmentation and dispatch latency.
+//
+//   soak [--windows N | --duration SECONDS] [--messages M] [--seed S] [--max-heap-growth BYTES] [--max-drift RATIO]
+//
+// The traffic comes from SyntheticTraffic seeded with --seed, the same seed replays the same run. Shadow traffic
+// includes names that were never registered, which must not leave anything behind in the client. --duration runs
+// windows until that much wall time has passed, for multi-hour runs, instead of a fixed --windows count.
+//
+// The first window is a warm-up and becomes the baseline. The run fails when heap in use grows by more than
+// --max-heap-growth over the baseline, or when the p50 latency of the last window exceeds the baseline's by more
+// than --max-drift times (0 turns the latency check off, shared CI machines are too noisy for it).
+
+#include "HostStats.h"
+#include "SyntheticTraffic.h"
+
+#include <AwsIoTCore.h>
+#include <AwsOutbound.h>
+#include <HostHeap.h>
+
+#include <cstdio>
+
+struct SoakWindow {
+    uint64_t bytesInUse;
+    uint32_t minFree;
+    uint32_t largestBlock;
+    double fragmentation;
+    double allocationsPerMessage;
+    uint64_t p50Nanos;
+    uint64_t p99Nanos;
+    uint64_t maxNanos;
+};
+
+int main(int argc, char **argv) {
+    unsigned long windows = optionNumber(argc, argv, "--windows", 20);
+    unsigned long duration = optionNumber(argc, argv, "--duration", 0);
+    uint64_t seed = optionNumber(argc, argv, "--seed", 1);
+    unsigned long messages = optionNumber(argc, argv, "--messages", 5000);
+    unsigned long maxHeapGrowth = optionNumber(argc, argv, "--max-heap-growth", 2048);
+    double maxDrift = optionDouble(argc, argv, "--max-drift", 0);
+
+    Serial.setMuted(true);
+    hostUseManualClock(true);
+    hostSetMicros(1000000);
+
+    PubSubClient mqtt;
+    mqtt.setBufferSize(1024);
+    ThingClient client(&mqtt, SYNTHETIC_THING_NAME);
+    OutboundScheduler scheduler(&mqtt);
+    scheduler.setDropPolicy(LANE_TELEMETRY, DROP_OLDEST);
+    client.setOutboundScheduler(&scheduler);
+
+    String reply;
+    attachSyntheticHandlers(client, reply);
+
+    client.begin();
+    registerSyntheticShadows(client);
+#ifdef AWS_IOT_METRICS
+    client.setMetricsReporting("diagnostics", 60000);
+#endif
+
+    SyntheticTraffic traffic(seed);
+    String topic;
+    topic.reserve(128);
+    std::vector<uint64_t> latencies;
+    latencies.reserve(messages);
+    SoakWindow baseline{};
+    SoakWindow last{};
+
+    hostHeapResetBaseline();
+    uint64_t endAt = wallMicros() + (uint64_t) duration * 1000000;
+    printf("seed %llu\n", (unsigned long long) seed);
+    printf("%6s %10s %10s %10s %8s %10s %10s %10s %10s\n",
+           "window", "inUse", "minFree", "largest", "frag", "allocs/msg", "p50(ns)", "p99(ns)", "max(ns)");
+
+    unsigned long window = 0;
+    for (; duration > 0 ? wallMicros() < endAt : window < windows; window++) {
+        latencies.clear();
+        uint64_t allocationsBefore = hostHeapCounters().allocations;
+
+        for (unsigned long i = 0; i < messages; i++) {
+            JsonDocument &payload = traffic.next(topic);
+
+            uint64_t startedAt = wallNanos();
+            client.onMessage(topic, payload);
+            latencies.push_back(wallNanos() - startedAt);
+
+            if (i % 10 == 9) {
+                hostAdvanceMicros(100000);
+                client.loop();
+            }
+        }
+
+        // The last payload and reply are sized by the random draw, let them go so they do not show up as growth.
+        traffic.release();
+        reply = String();
+
+        SoakWindow result{};
+        HostHeapCounters counters = hostHeapCounters();
+        result.bytesInUse = counters.bytesInUse;
+        result.minFree = hostHeapMinFree();
+        result.largestBlock = hostHeapLargestFreeBlock();
+        uint32_t free = hostHeapFree();
+        result.fragmentation = free > 0 ? 1.0 - (double) result.largestBlock / free : 0;
+        result.allocationsPerMessage = (double) (counters.allocations - allocationsBefore) / (double) messages;
+        result.maxNanos = *std::max_element(latencies.begin(), latencies.end());
+        result.p99Nanos = percentile(latencies, 99);
+        result.p50Nanos = percentile(latencies, 50);
+        (window == 0 ? baseline : last) = result;
+
+        printf("%6lu %10llu %10u %10u %7.1f%% %10.2f %10llu %10llu %10llu\n", window,
+               (unsigned long long) result.bytesInUse, result.minFree, result.largestBlock,
+               result.fragmentation * 100, result.allocationsPerMessage, (unsigned long long) result.p50Nanos,
+               (unsigned long long) result.p99Nanos, (unsigned long long) result.maxNanos);
+        fflush(stdout);
+    }
+
+    if (window < 2) {
+        return 0;
+    }
+
+    long long heapGrowth = (long long) last.bytesInUse - (long long) baseline.bytesInUse;
+    double drift = baseline.p50Nanos > 0 ? (double) last.p50Nanos / (double) baseline.p50Nanos : 0;
+    printf("heap growth since warm-up: %lld bytes, p50 drift: %.2fx\n", heapGrowth, drift);
+
+    int status = 0;
+    if (!hostHeapTracking()) {
+        printf("heap tracking is off in sanitizer builds, skipping the heap check\n");
+    } else if (heapGrowth > (long long) maxHeapGrowth) {
+        printf("FAIL: heap grew by more than %lu bytes\n", maxHeapGrowth);
+        status = 1;
+    }
+
+    if (maxDrift > 0 && drift > maxDrift) {
+        printf("FAIL: p50 latency drifted by more than %.2fx\n", maxDrift);
+        status = 1;
+    }
+    return status;
+}
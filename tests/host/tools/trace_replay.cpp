@@ -0,0 +1,178 @@
+// Replays a recorded trace through ThingClient with TraceReplayer, the same code a bench device runs, and checks
+// the result against thresholds so a regression in the message paths fails the build.
+//
+//   trace_replay TRACE [--passes N] [--speed S] [--min-handled N] [--max-p99-us US]
+//                      [--max-allocs-per-message A] [--max-heap-growth BYTES]
+//   trace_replay --record TRACE [--messages N]
+//
+// The first pass warms up the client and the replayer, the later ones are measured: dispatch p99 (upper bound of
+// the histogram bucket), messages per second, allocations per message and heap in use after each pass. --speed
+// keeps the recorded timing (1), compresses it (above 1) or replays as fast as possible (0, the default), the
+// replayer spins on yield() until each record is due. --record writes a new trace from the synthetic traffic the
+// soak run uses, which is how test/traces/synthetic.trace was made.
+
+#include "HostStats.h"
+#include "SyntheticTraffic.h"
+
+#include <AwsIoTCore.h>
+#include <AwsTrace.h>
+#include <HostHeap.h>
+
+#include <cstdio>
+#include <string>
+
+// Bucket b of AwsLatencyHistogram holds [2^(b-1), 2^b) microseconds, report the upper bound it guarantees.
+static uint32_t histogramPercentile(const AwsLatencyHistogram &histogram, double percent) {
+    uint64_t target = (uint64_t) (percent / 100.0 * histogram.count + 0.5);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < AWS_METRICS_HISTOGRAM_BUCKETS; bucket++) {
+        seen += histogram.buckets[bucket];
+        if (seen >= target && seen > 0) {
+            return bucket + 1 == AWS_METRICS_HISTOGRAM_BUCKETS ? histogram.maxMicros : 1u << bucket;
+        }
+    }
+    return histogram.maxMicros;
+}
+
+// Splits a host path into the directory HostFS is rooted at and the file name inside it.
+static void splitPath(const std::string &path, std::string &root, String &name) {
+    size_t slash = path.rfind('/');
+    root = slash == std::string::npos ? "." : path.substr(0, slash == 0 ? 1 : slash);
+    name = String("/") + (slash == std::string::npos ? path : path.substr(slash + 1)).c_str();
+}
+
+static int record(const char *path, unsigned long messages) {
+    std::string root;
+    String name;
+    splitPath(path, root, name);
+    fs::HostFS hostFS(root);
+
+    hostUseManualClock(true);
+    hostSetMicros(1000000);
+
+    PubSubClient mqtt;
+    ThingClient client(&mqtt, SYNTHETIC_THING_NAME);
+    TraceRecorder recorder;
+    if (!recorder.begin(hostFS, name)) {
+        printf("cannot write %s\n", path);
+        return 1;
+    }
+    client.setTraceRecorder(&recorder);
+    client.begin();
+    registerSyntheticShadows(client);
+
+    SyntheticTraffic traffic;
+    String topic;
+    for (unsigned long i = 0; i < messages; i++) {
+        JsonDocument &payload = traffic.next(topic);
+        client.onMessage(topic, payload);
+        hostAdvanceMicros(20000);
+        client.loop();
+    }
+
+    recorder.end();
+    printf("recorded %u messages (%u failed) to %s\n", recorder.getRecordCount(), recorder.getFailedCount(), path);
+    return recorder.getFailedCount() == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    const char *recordPath = option(argc, argv, "--record", nullptr);
+    if (recordPath != nullptr) {
+        return record(recordPath, optionNumber(argc, argv, "--messages", 120));
+    }
+
+    if (argc < 2 || argv[1][0] == '-') {
+        printf("usage: trace_replay TRACE [--passes N] [--speed S] [--min-handled N] [--max-p99-us US]\n"
+               "                          [--max-allocs-per-message A] [--max-heap-growth BYTES]\n"
+               "       trace_replay --record TRACE [--messages N]\n");
+        return 2;
+    }
+
+    unsigned long passes = optionNumber(argc, argv, "--passes", 20);
+    double speed = optionDouble(argc, argv, "--speed", 0);
+    unsigned long minHandled = optionNumber(argc, argv, "--min-handled", 0);
+    unsigned long maxP99 = optionNumber(argc, argv, "--max-p99-us", 0);
+    double maxAllocations = optionDouble(argc, argv, "--max-allocs-per-message", 0);
+    unsigned long maxHeapGrowth = optionNumber(argc, argv, "--max-heap-growth", 1024);
+
+    std::string root;
+    String name;
+    splitPath(argv[1], root, name);
+    fs::HostFS hostFS(root);
+
+    Serial.setMuted(true);
+
+    PubSubClient mqtt;
+    mqtt.setBufferSize(1024);
+    ThingClient client(&mqtt, SYNTHETIC_THING_NAME);
+    String reply;
+    attachSyntheticHandlers(client, reply);
+    client.begin();
+    registerSyntheticShadows(client);
+
+    TraceReplayer replayer;
+    TraceReplayStats stats{};
+    uint64_t baselineBytes = 0;
+    uint32_t worstP99 = 0;
+    double worstAllocations = 0;
+    uint64_t measuredMessages = 0;
+    uint64_t measuredMicros = 0;
+    bool ok = true;
+
+    printf("%5s %8s %8s %6s %10s %8s %8s %10s %10s\n",
+           "pass", "messages", "handled", "errors", "msg/s", "p99(us)", "max(us)", "allocs/msg", "inUse");
+
+    for (unsigned long pass = 0; pass < passes; pass++) {
+        uint64_t allocationsBefore = hostHeapCounters().allocations;
+        if (!replayer.replay(hostFS, name, client, (float) speed, stats)) {
+            printf("cannot replay %s\n", argv[1]);
+            return 1;
+        }
+
+        HostHeapCounters heap = hostHeapCounters();
+        uint32_t p99 = histogramPercentile(stats.dispatchMicros, 99);
+        double allocations = stats.messages > 0
+                                 ? (double) (heap.allocations - allocationsBefore) / (double) stats.messages
+                                 : 0;
+        double rate = stats.elapsedMicros > 0 ? stats.messages * 1e6 / (double) stats.elapsedMicros : 0;
+        printf("%5lu %8u %8u %6u %10.0f %8u %8u %10.2f %10llu\n", pass, stats.messages, stats.handled, stats.errors,
+               rate, p99, stats.dispatchMicros.maxMicros, allocations, (unsigned long long) heap.bytesInUse);
+
+        if (stats.errors > 0 || stats.messages == 0 || stats.handled < minHandled) {
+            ok = false;
+        }
+
+        if (pass == 0) {
+            baselineBytes = heap.bytesInUse;
+            continue;
+        }
+        measuredMessages += stats.messages;
+        measuredMicros += stats.elapsedMicros;
+        worstP99 = std::max(worstP99, p99);
+        worstAllocations = std::max(worstAllocations, allocations);
+    }
+
+    long long heapGrowth = (long long) hostHeapCounters().bytesInUse - (long long) baselineBytes;
+    printf("after warm-up: %.0f msg/s, worst p99 %u us, worst %.2f allocations per message, heap growth %lld bytes\n",
+           measuredMicros > 0 ? measuredMessages * 1e6 / (double) measuredMicros : 0, worstP99, worstAllocations,
+           heapGrowth);
+
+    if (!ok) {
+        printf("FAIL: replay errors or fewer than %lu handled messages\n", minHandled);
+    }
+    if (maxP99 > 0 && worstP99 > maxP99) {
+        printf("FAIL: dispatch p99 above %lu us\n", maxP99);
+        ok = false;
+    }
+    if (hostHeapTracking()) {
+        if (maxAllocations > 0 && worstAllocations > maxAllocations) {
+            printf("FAIL: more than %.2f allocations per message\n", maxAllocations);
+            ok = false;
+        }
+        if (heapGrowth > (long long) maxHeapGrowth) {
+            printf("FAIL: heap grew by more than %lu bytes\n", maxHeapGrowth);
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}